@@ -0,0 +1,189 @@
+/**
+ *  Copyright (C) 2013 KU Leuven
+ *
+ *  This file is part of EnsembleSVM.
+ *
+ *  EnsembleSVM is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published
+ *  by the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  EnsembleSVM is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with EnsembleSVM.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Approximation.hpp
+ *
+ *      Author: Marc Claesen
+ */
+
+#ifndef APPROXIMATION_HPP_
+#define APPROXIMATION_HPP_
+
+/*************************************************************************************************/
+
+#include <memory>
+#include <vector>
+#include <iostream>
+#include "SparseVector.hpp"
+#include "Kernel.hpp"
+#include "Models.hpp"
+#include "Ensemble.hpp"
+
+/*************************************************************************************************/
+
+namespace ensemble{
+
+/*************************************************************************************************/
+
+/**
+ * Explicit, finite dimensional feature map.
+ *
+ * Kernel expansions over SVs are approximated by linear functions of the features.
+ */
+class FeatureMap{
+public:
+	/**
+	 * Returns the amount of features.
+	 */
+	virtual size_t dimension() const=0;
+
+	/**
+	 * Writes the features of x into z, which must contain dimension() elements.
+	 */
+	virtual void transform(const SparseVector& x, std::vector<double>& z) const=0;
+
+	/**
+	 * Returns the features of an SV, such that k(sv,x) is approximated by the
+	 * inner product between features(sv) and transform(x).
+	 */
+	virtual std::vector<double> features(const SparseVector& sv) const=0;
+
+	virtual void serialize(std::ostream& os) const=0;
+
+	/**
+	 * Reads a FeatureMap, the first line must contain its name.
+	 */
+	static unique_ptr<FeatureMap> read(std::istream& is);
+
+	virtual ~FeatureMap(){}
+};
+
+/**
+ * Random Fourier features for RBF kernels: z_j(x) = sqrt(2/D) cos(w_j'x + b_j).
+ *
+ * Frequencies are only drawn for the first <numinputs> features. The contribution of
+ * higher features to the squared distance to any SV is exact and applied as a scale factor.
+ */
+class RandomFourierFeatures final : public FeatureMap{
+private:
+	double gamma;
+	size_t numinputs;
+
+	// frequencies, row f-1 contains w_j[f] for all features j
+	std::vector<double> frequencies;
+	std::vector<double> offsets;
+
+public:
+	RandomFourierFeatures(double gamma, size_t numinputs, size_t D, unsigned seed);
+	RandomFourierFeatures(double gamma, size_t numinputs, std::vector<double>&& frequencies, std::vector<double>&& offsets);
+
+	virtual size_t dimension() const override;
+	virtual void transform(const SparseVector& x, std::vector<double>& z) const override;
+	virtual std::vector<double> features(const SparseVector& sv) const override;
+	virtual void serialize(std::ostream& os) const override;
+
+	static constexpr const char* NAME="RandomFourierFeatures";
+	static unique_ptr<RandomFourierFeatures> read(std::istream& is);
+};
+
+/**
+ * Nyström features: kernel evaluations to a set of landmarks.
+ *
+ * Features of SVs are premultiplied by the pseudo-inverse of the landmark kernel matrix.
+ */
+class NystroemFeatures final : public FeatureMap{
+private:
+	unique_ptr<Kernel> kernel;
+	std::vector<SparseVector> landmarks;
+	std::vector<double> squares;
+
+	// Cholesky factor L of the (regularized) landmark kernel matrix, row-major
+	std::vector<double> cholesky;
+
+public:
+	NystroemFeatures(unique_ptr<Kernel> kernel, std::vector<SparseVector>&& landmarks);
+
+	virtual size_t dimension() const override;
+	virtual void transform(const SparseVector& x, std::vector<double>& z) const override;
+	virtual std::vector<double> features(const SparseVector& sv) const override;
+	virtual void serialize(std::ostream& os) const override;
+
+	static constexpr const char* NAME="NystroemFeatures";
+	static unique_ptr<NystroemFeatures> read(std::istream& is);
+};
+
+/*************************************************************************************************/
+
+/**
+ * Approximation of an SVMEnsemble via an explicit feature map.
+ *
+ * Base model i has decision value weights_i'z(x) - rho_i, so predictions cost
+ * O(D*nnz(x) + D*size()) regardless of the amount of SVs.
+ */
+class ApproximateEnsemble final : public BinaryModel{
+private:
+	unique_ptr<FeatureMap> map;
+
+	// weights, row i belongs to base model i
+	std::vector<double> weights;
+	std::vector<double> rhos;
+
+	std::string positive;
+	std::string negative;
+
+public:
+	ApproximateEnsemble(unique_ptr<FeatureMap> map, std::vector<double>&& weights, std::vector<double>&& rhos,
+			const std::string& positive, const std::string& negative);
+
+	/**
+	 * Approximates all base models of ens using D random Fourier features. Requires an RBF kernel.
+	 */
+	static unique_ptr<ApproximateEnsemble> fourier(const SVMEnsemble& ens, size_t D, unsigned seed);
+
+	/**
+	 * Approximates all base models of ens using D landmarks, sampled from its distinct SVs.
+	 */
+	static unique_ptr<ApproximateEnsemble> nystroem(const SVMEnsemble& ens, size_t D, unsigned seed);
+
+	/**
+	 * Majority vote prediction, scores are as in SVMEnsemble::predict().
+	 */
+	virtual Prediction predict(const SparseVector &i) const override;
+	virtual Prediction predict(const std::vector<double> &i) const override;
+
+	virtual std::vector<double> decision_value(const SparseVector &i) const override;
+	virtual std::vector<double> decision_value(const std::vector<double> &i) const override;
+
+	virtual std::string positive_label() const override;
+	virtual std::string negative_label() const override;
+	virtual size_t num_outputs() const override;
+
+	size_t dimension() const;
+
+	virtual void serialize(std::ostream& os) const override;
+
+	REGISTER_BINARYMODEL_IN_CLASS(ApproximateEnsemble)
+};
+
+/*************************************************************************************************/
+
+} // ensemble namespace
+
+/*************************************************************************************************/
+
+#endif /* APPROXIMATION_HPP_ */
@@ -67,6 +67,34 @@ protected:
 	std::string positive;
 	std::string negative;
 
+	// explicit form of the postprocessing if it is a MajorityVote, used by predict_label()
+	bool majorityvote=false;
+	pipeline::VotingScheme votes;
+
+	// element i bounds the summed votes of predictor outputs i and higher
+	std::vector<double> maxRemaining;
+	std::vector<double> minRemaining;
+
+	// bound on rounding errors when summing votes
+	double voteErrorBound=0.0;
+
+	/**
+	 * Aggregates the predictor's decision values into the workflow's output.
+	 */
+	std::vector<double> postprocess(Vector&& intermediate) const;
+
+	/**
+	 * Returns the aggregated value of intermediate, passing ctx.decision_values to the postprocessing.
+	 *
+	 * Majority votes are evaluated directly on intermediate, without allocating.
+	 */
+	double postprocess(PredictionContext& ctx, const Vector& intermediate) const;
+
+	/**
+	 * Extracts the voting scheme of the postprocessing pipeline, if any.
+	 */
+	void update_votingscheme();
+
 public:
 	BinaryWorkflow(
 				std::unique_ptr<Preprocessing> preprocess,
@@ -100,6 +128,49 @@ public:
 	virtual std::vector<double> decision_value(const SparseVector &i) const override;
 	virtual std::vector<double> decision_value(const std::vector<double> &i) const override;
 
+	/**
+	 * Predictions for a view of a test instance.
+	 *
+	 * Without preprocessing, the view is passed to the predictor as is.
+	 */
+	virtual Prediction predict(const SparseVectorView& v) const override;
+	virtual std::vector<double> decision_value(const SparseVectorView &i) const override;
+
+	/**
+	 * Predictions reusing the buffers of ctx for the predictor's outputs and the result.
+	 *
+	 * Majority votes are aggregated without allocating, other postprocessing pipes read
+	 * the predictor's outputs from ctx. Preprocessing still allocates the preprocessed instance.
+	 */
+	virtual const Prediction& predict(PredictionContext& ctx, const SparseVectorView& v) const override;
+	virtual const std::vector<double>& decision_value(PredictionContext& ctx, const SparseVectorView &i) const override;
+	virtual void reserve(PredictionContext& ctx) const override;
+
+	/**
+	 * Returns the decision values for a block of test instances.
+	 *
+	 * The block is forwarded to the predictor as a whole.
+	 */
+	virtual std::vector<std::vector<double>> decision_values(const std::vector<const SparseVector*>& batch) const override;
+
+	/**
+	 * Predicts the label of v, the returned Prediction contains no scores.
+	 *
+	 * If the predictor is an SVMEnsemble and postprocessing is a MajorityVote, base models
+	 * are evaluated one by one until the remaining votes can no longer change the label.
+	 * The label always equals that of predict(v).
+	 */
+	Prediction predict_label(const SparseVectorView& v) const;
+
+	/**
+	 * Folds a LinearAggregation or LogisticRegression over an SVMEnsemble into a single SVMModel.
+	 *
+	 * The predictor becomes one kernel expansion over the ensemble's distinct SVs and the
+	 * aggregation an identity (or plain logistic), so predictions are unchanged up to rounding.
+	 * Returns false and leaves the workflow untouched if it does not have this form.
+	 */
+	bool fold_aggregation();
+
 	virtual size_t num_inputs() const;
 	virtual size_t num_outputs() const override;
 
@@ -116,6 +187,11 @@ public:
 	friend std::ostream& operator<<(std::ostream& os, const BinaryWorkflow& flow);
 	virtual void serialize(std::ostream& os) const override;
 
+	/**
+	 * Serializes the predictor in binary format, the pipeline remains in text.
+	 */
+	virtual void serialize_binary(std::ostream& os) const override;
+
 	REGISTER_BINARYMODEL_IN_CLASS(BinaryWorkflow)
 };
 
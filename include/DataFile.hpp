@@ -105,20 +105,23 @@ public:
 	~DataLine();
 };
 
+/**
+ * Line of a DataFile, which views the instance stored in the file.
+ */
 class ConstDataLine final{
 private:
 	const std::string* label;
-	const SparseVector* sv;
+	SparseVectorView sv;
 	bool islabeled;
 
 public:
-	ConstDataLine(const std::string* label, const SparseVector* sv);
-	ConstDataLine(const SparseVector* sv);
+	ConstDataLine(const std::string* label, const SparseVectorView& sv);
+	ConstDataLine(const SparseVectorView& sv);
 	ConstDataLine(ConstDataLine&& o);
 
 	bool labeled() const;
 
-	const SparseVector *rawSV() const;
+	const SparseVectorView& rawView() const;
 	const std::string *rawLabel() const;
 
 	~ConstDataLine();
@@ -126,6 +129,13 @@ public:
 
 /*************************************************************************************************/
 
+/**
+ * Instances of a data file, held in memory.
+ *
+ * By default every instance is a SparseVector. Files read as packed hold all instances in one
+ * SparseMatrix instead, which takes 12 bytes per nonzero (32-bit index and value) rather than 16
+ * and no allocation per instance. Instances are returned as views in both cases.
+ */
 class DataFile{
 public:
 	typedef std::deque<std::unique_ptr<SparseVector>> Instances;
@@ -138,17 +148,30 @@ protected:
 	 * Dummy constructor, used by subclasses.
 	 * Does nothing.
 	 */
-	DataFile();
+	DataFile(bool packed=false);
 	Instances instances;
 
+	// instances of packed files, see readf()
+	SparseMatrix packedInstances;
+	bool packed;
+
 	DataFile &operator=(const DataFile &orig);
 	DataFile(const DataFile &orig);
 
-	static unique_ptr<DataFile> readf(std::istream &iss, int format=0);
+	/**
+	 * Appends an instance, in packedInstances if this file is packed.
+	 */
+	void add(unique_ptr<SparseVector> sv);
+
+	static unique_ptr<DataFile> readf(std::istream &iss, int format=0, bool packed=false);
 
 public:
 	DataFile(const std::string &filename);
-	virtual const SparseVector *operator[](unsigned instance) const;
+
+	/**
+	 * Returns a view of the specified instance, valid as long as this file.
+	 */
+	virtual SparseVectorView operator[](unsigned instance) const;
 	virtual std::shared_ptr<ConstDataLine> getdataline(unsigned instance) const;
 
 	/**
@@ -157,7 +180,10 @@ public:
 	virtual unsigned size() const;
 	virtual ~DataFile();
 
-	static unique_ptr<DataFile> readf(const std::string &fname, int format=0);
+	/**
+	 * Reads a DataFile from fname with specified format, with packed instances if packed is true.
+	 */
+	static unique_ptr<DataFile> readf(const std::string &fname, int format=0, bool packed=false);
 
 	/**
 	 * Reads an unlabeled comma seperated file of the following format (p dimensional problem)
@@ -200,15 +226,16 @@ protected:
 	 * Dummy constructor, used by subclasses.
 	 * Does nothing.
 	 */
-	LabeledDataFile();
+	LabeledDataFile(bool packed=false);
 	LabelSet labels;
-	LabelMap labelmap;
+	LabelMap labelmap;	// instances are null in packed files
 
 	/**
 	 * Attempts to add label to the set of labels. The LabeledDataFile acquires ownership of the label.
 	 */
 	const Label *addLabel(unique_ptr<Label> label);
-	static unique_ptr<LabeledDataFile> readf(std::istream &iss, int format=0, const std::deque<unsigned> *indices=NULL);
+	static unique_ptr<LabeledDataFile> readf(std::istream &iss, int format=0, const std::deque<unsigned> *indices=NULL,
+			bool packed=false);
 
 public:
 //	LabeledDataFile(const std::string &filename);
@@ -223,8 +250,10 @@ public:
 	 * Reads a LabeledDataFile from fname with specified format.
 	 *
 	 * If a list of indices is specified (e.g. not NULL), only those line numbers are read.
+	 * Instances are packed if packed is true, see DataFile.
 	 */
-	static unique_ptr<LabeledDataFile> readf(const std::string &fname, int format=0, const std::deque<unsigned> *indices=NULL);
+	static unique_ptr<LabeledDataFile> readf(const std::string &fname, int format=0, const std::deque<unsigned> *indices=NULL,
+			bool packed=false);
 
 	/**
 	 * Reads a labeled comma seperated file of the following format (p dimensional problem)
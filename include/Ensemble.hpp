@@ -28,6 +28,7 @@
 
 #include <memory>
 #include <iostream>
+#include <functional>
 #include "Models.hpp"
 #include "Kernel.hpp"
 #include "config.h"
@@ -68,6 +69,23 @@ public:
 	}
 };
 
+/**
+ * Content-based hashing and equality of SVs, used to intern SVs in unordered containers.
+ */
+class SVHash{
+public:
+	size_t operator()(const SparseVector *v) const{
+		return v->hash();
+	}
+};
+
+class SVEqual{
+public:
+	bool operator()(const SparseVector *v1, const SparseVector *v2) const{
+		return (*v1)==(*v2);
+	}
+};
+
 /*************************************************************************************************/
 
 class SVMEnsembleImpl;
@@ -85,10 +103,10 @@ public:
 			std::deque<std::shared_ptr<SparseVector>>::const_iterator
 			>::type sv_const_iterator;
 	typedef make_any_iterator_type<
-			std::map<SVMModel*,int>::iterator
+			std::vector<std::pair<SVMModel*,int>>::iterator
 			>::type iterator;
 	typedef make_any_iterator_type<
-			std::map<SVMModel*,int>::const_iterator
+			std::vector<std::pair<SVMModel*,int>>::const_iterator
 			>::type const_iterator;
 
 	typedef std::map< std::string, std::string > LabelMap;
@@ -116,6 +134,7 @@ public:
 	 * Subsequent scores are decision values per base model.
 	 */
 	virtual Prediction predict(const SparseVector &i) const override;
+	virtual Prediction predict(const SparseVectorView &i) const override;
 
 	/**
 	 * Dense prediction.
@@ -126,8 +145,52 @@ public:
 	 * Returns the base model decision values for prediction of the test instance.
 	 */
 	virtual std::vector<double> decision_value(const SparseVector &i) const override final;
+	virtual std::vector<double> decision_value(const SparseVectorView &i) const override final;
 	virtual std::vector<double> decision_value(const std::vector<double> &i) const override final;
 
+	/**
+	 * Predictions reusing the buffers of ctx, which do not allocate once ctx has been used with this ensemble.
+	 */
+	virtual const Prediction& predict(PredictionContext& ctx, const SparseVectorView &x) const override;
+	virtual const std::vector<double>& decision_value(PredictionContext& ctx, const SparseVectorView &x) const override;
+	virtual void reserve(PredictionContext& ctx) const override;
+
+	/**
+	 * Returns the base model decision values for a block of test instances.
+	 *
+	 * Kernel evaluations are performed in tiles of SVs x instances,
+	 * so each SV is read from memory once per tile rather than once per instance.
+	 */
+	virtual std::vector<std::vector<double>> decision_values(const std::vector<const SparseVector*>& batch) const override final;
+
+	/**
+	 * Evaluates the base models one by one, computing kernel evaluations only when a model needs them.
+	 *
+	 * After each base model, stop(model index, decision value) is called and evaluation ends
+	 * when it returns true. Returns the decision values of all evaluated models, which are
+	 * identical to those of decision_value(i).
+	 */
+	std::vector<double> lazy_decision_value(const SparseVectorView &i, const std::function<bool(size_t,double)>& stop) const;
+
+	/**
+	 * Returns a single SVMModel over the distinct SVs, with decision value
+	 * 		sum_i coeffs[i]*(decision value of base model i) + offset
+	 *
+	 * If coeffs contains one element, it is used for all base models.
+	 */
+	std::unique_ptr<SVMModel> combine(const std::vector<double>& coeffs, double offset) const;
+
+	/**
+	 * Merges distinct SVs that lie within Euclidean distance <tolerance> of each other.
+	 *
+	 * Each SV is replaced by a representative SV of its cluster, and coefficients of SVs
+	 * that end up identical within a base model are summed. Returns the amount of
+	 * distinct SVs that were removed.
+	 *
+	 * Merging is exact for tolerance 0; larger tolerances trade accuracy for prediction cost.
+	 */
+	size_t merge(double tolerance);
+
 	// Adds SVM model *m to the SVMEnsemble.
 	virtual void add(std::unique_ptr<SVMModel> m);
 
@@ -158,14 +221,87 @@ public:
 
 	const Kernel *getKernel() const;
 
+	/**
+	 * Splits every single prediction over <numthreads> threads, which are kept alive by the ensemble.
+	 *
+	 * Kernel evaluations are split by ranges of distinct SVs and aggregation by ranges of base models,
+	 * each only if there are enough SVs. Has no effect without pthreads support, 0 or 1 disables it.
+	 */
+	void set_num_threads(unsigned numthreads);
+
+	/**
+	 * Stores the SV values and dual coefficients used for predictions in single precision.
+	 *
+	 * Kernel evaluations and aggregation still accumulate in double precision, but read half the memory.
+	 * SVs and models themselves remain in double precision, so this can be reverted without loss.
+	 * The setting is serialized with the ensemble.
+	 */
+	void set_single_precision(bool enable);
+	bool single_precision() const;
+
+	/**
+	 * Encodings of SV values in the binary format, see quantize().
+	 */
+	enum ValueEncoding{
+		DOUBLE_VALUES,	// lossless
+		FLOAT_VALUES,	// IEEE single precision
+		HALF_VALUES,	// IEEE half precision, magnitudes are clamped to 65504
+		INT8_VALUES		// 8 bit integers, scaled per feature by its largest magnitude over the SVs
+	};
+
+	/**
+	 * Predicts with SV values rounded to <encoding>, which serialization then uses to store them.
+	 *
+	 * Predictions of this ensemble equal those after saving and loading it, so the effect of
+	 * quantization can be measured before saving. The SVs and models keep their original values,
+	 * so another encoding is always applied to those and DOUBLE_VALUES restores exact predictions.
+	 * The encoding is serialized with the ensemble.
+	 *
+	 * With INT8_VALUES and a kernel based on inner products, predictions read the SVs as int8
+	 * levels, a byte per value, and scale each query by the feature scales instead. Adding models
+	 * whose SVs extend the range of a feature rescales the levels of all SVs.
+	 */
+	void quantize(ValueEncoding encoding);
+	ValueEncoding value_encoding() const;
+
 	virtual void printSV(std::ostream &os, int SVidx) const;
 	friend std::ostream &operator<<(std::ostream &os, const SVMEnsemble &v);
 	friend class SVMEnsembleImpl;
 
 	virtual void serialize(std::ostream& os) const override;
+
+	/**
+	 * Serializes in a versioned binary format with aligned sections, which read() recognizes.
+	 *
+	 * Loading via BinaryModel::load() maps the file and decodes the ensemble from it without parsing numbers,
+	 * copying the SVs and coefficients into memory of its own.
+	 * Feature indices are stored as variable length differences, values according to value_encoding().
+	 */
+	virtual void serialize_binary(std::ostream& os) const override;
+
 	static unique_ptr<SVMEnsemble> read(std::istream &iss);
 	static unique_ptr<SVMEnsemble> load(const string &fname);
 
+	/**
+	 * Loads the base models with indices in <selection>, in that order, from a model file that contains
+	 * an SVMEnsemble, e.g. within a BinaryWorkflow.
+	 *
+	 * In binary format, only the selected models and the SVs they refer to are read from the mapped file.
+	 * Ensembles in text format are read entirely.
+	 */
+	static unique_ptr<SVMEnsemble> load(const string &fname, const std::vector<unsigned>& selection);
+
+	/**
+	 * Sets the amount of threads used to read large text ensembles in memory, e.g. via BinaryModel::load().
+	 *
+	 * SVs are parsed in chunks and models independently, before they are added in order.
+	 * Defaults to std::thread::hardware_concurrency() for 0. Has no effect without pthreads support.
+	 */
+	static void set_read_threads(unsigned numthreads);
+
+	/**
+	 * Returns the fraction of nonzeros in the distinct SVs, relative to the largest feature index.
+	 */
 	double density() const;
 
 	/**
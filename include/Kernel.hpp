@@ -80,6 +80,35 @@ public:
 	virtual double k_function(const SparseVector *x, const SparseVector *y) const=0;
 	virtual double k_function(const_iterator Ix, const_iterator Ex, const_iterator Iy, const_iterator Ey) const=0;
 
+	/**
+	 * Computes <x,y> using the current kernel, without copying either argument.
+	 *
+	 * Views wrap SparseVectors, rows of a SparseMatrix and svm_node arrays, x may also be a row of a SparseMatrixF.
+	 */
+	virtual double k_function(const SparseVectorView& x, const SparseVectorView& y) const=0;
+	virtual double k_function(const SparseRowF& x, const SparseVectorView& y) const=0;
+
+	/**
+	 * Computes the kernel based on <x,y> and the squared norms |x|^2 and |y|^2.
+	 *
+	 * Only valid if isInnerProductBased().
+	 */
+	virtual double k_function(double inner, double xsquare, double ysquare) const;
+
+	/**
+	 * Transforms n inner products <x,y_i> into kernel evaluations k(x,y_i), in place.
+	 *
+	 * ysquares contains the squared norms |y_i|^2. Nonlinearities are applied in a single
+	 * batch (cfr. exponential()). Only valid if isInnerProductBased().
+	 */
+	virtual void k_function(double *inner, const double *ysquares, double xsquare, size_t n) const;
+
+	/**
+	 * Returns whether this kernel depends on its arguments only through
+	 * their inner product and squared norms.
+	 */
+	virtual bool isInnerProductBased() const;
+
 	/**
 	 * Returns the type of this kernel as defined by the enum in this header.
 	 */
@@ -138,6 +167,11 @@ public:
 	LinearKernel(const LinearKernel &orig);
 	double k_function(const SparseVector *x, const SparseVector *y) const override;
 	double k_function(const_iterator Ix, const_iterator Ex, const_iterator Iy, const_iterator Ey) const override;
+	double k_function(const SparseVectorView& x, const SparseVectorView& y) const override;
+	double k_function(const SparseRowF& x, const SparseVectorView& y) const override;
+	double k_function(double inner, double xsquare, double ysquare) const override;
+	void k_function(double *inner, const double *ysquares, double xsquare, size_t n) const override;
+	virtual bool isInnerProductBased() const override;
 	virtual unique_ptr<Kernel> clone() const override;
 	virtual ~LinearKernel();
 	virtual bool operator==(const Kernel &other) const override;
@@ -179,6 +213,11 @@ public:
 	PolyKernel(const PolyKernel &orig);
 	double k_function(const SparseVector *x, const SparseVector *y) const override;
 	double k_function(const_iterator Ix, const_iterator Ex, const_iterator Iy, const_iterator Ey) const override;
+	double k_function(const SparseVectorView& x, const SparseVectorView& y) const override;
+	double k_function(const SparseRowF& x, const SparseVectorView& y) const override;
+	double k_function(double inner, double xsquare, double ysquare) const override;
+	void k_function(double *inner, const double *ysquares, double xsquare, size_t n) const override;
+	virtual bool isInnerProductBased() const override;
 
 	virtual bool operator==(const Kernel &other) const override;
 	bool operator==(const PolyKernel &other) const;
@@ -229,6 +268,11 @@ public:
 	RBFKernel(const RBFKernel &orig);
 	double k_function(const SparseVector *x, const SparseVector *y) const override;
 	double k_function(const_iterator Ix, const_iterator Ex, const_iterator Iy, const_iterator Ey) const override;
+	double k_function(const SparseVectorView& x, const SparseVectorView& y) const override;
+	double k_function(const SparseRowF& x, const SparseVectorView& y) const override;
+	double k_function(double inner, double xsquare, double ysquare) const override;
+	void k_function(double *inner, const double *ysquares, double xsquare, size_t n) const override;
+	virtual bool isInnerProductBased() const override;
 
 	virtual bool operator==(const Kernel &other) const override;
 	bool operator==(const RBFKernel &other) const;
@@ -273,6 +317,11 @@ public:
 	SigmoidKernel(const SigmoidKernel &orig);
 	double k_function(const SparseVector *x, const SparseVector *y) const override;
 	double k_function(const_iterator Ix, const_iterator Ex, const_iterator Iy, const_iterator Ey) const override;
+	double k_function(const SparseVectorView& x, const SparseVectorView& y) const override;
+	double k_function(const SparseRowF& x, const SparseVectorView& y) const override;
+	double k_function(double inner, double xsquare, double ysquare) const override;
+	void k_function(double *inner, const double *ysquares, double xsquare, size_t n) const override;
+	virtual bool isInnerProductBased() const override;
 
 	bool operator==(const SigmoidKernel &other) const;
 	virtual bool operator==(const Kernel &other) const override;
@@ -315,6 +364,8 @@ public:
 	UserdefKernel(const UserdefKernel &orig);
 	double k_function(const SparseVector *x, const SparseVector *y) const override;
 	double k_function(const_iterator Ix, const_iterator Ex, const_iterator Iy, const_iterator Ey) const override;
+	double k_function(const SparseVectorView& x, const SparseVectorView& y) const override;
+	double k_function(const SparseRowF& x, const SparseVectorView& y) const override;
 	virtual bool operator==(const Kernel &other) const override;
 	bool operator==(const UserdefKernel &other) const;
 	virtual unique_ptr<Kernel> clone() const override;
@@ -77,6 +77,11 @@ public:
 	~Prediction()=default;
 	void setLabel(const string &label);
 	void setScore(Score score, unsigned idx);
+
+	/**
+	 * Sets the amount of scores, reusing the current storage when possible.
+	 */
+	void resize(unsigned numdecisions);
 	Score getScore(unsigned idx) const;
 	Label getLabel() const;
 	iterator begin();
@@ -87,6 +92,29 @@ public:
 	friend std::ostream &operator<<(std::ostream &os, const Prediction &pred);
 };
 
+class Model;
+
+/**
+ * Scratch space for predictions, reused over calls.
+ *
+ * Buffers grow to the sizes a model needs on first use, so in steady state
+ * Model::predict(PredictionContext&, x) does not allocate. A context may be used
+ * with several models, but not by several threads at once: use one per thread.
+ */
+class PredictionContext final{
+public:
+	PredictionContext()=default;
+
+	/**
+	 * Preallocates scratch space for predictions with model.
+	 */
+	explicit PredictionContext(const Model& model);
+
+	std::vector<double> cache;				// kernel evaluations
+	std::vector<double> decision_values;	// outputs of the innermost model
+	Prediction prediction;
+};
+
 /*************************************************************************************************/
 
 /**
@@ -116,6 +144,29 @@ public:
 	virtual std::vector<double> decision_value(const std::vector<double> &i) const=0;
 	virtual std::vector<double> decision_value(const struct svm_node *x) const;
 
+	/**
+	 * Predictions for a view of a test instance, e.g. a row of a SparseMatrix or an svm_node array.
+	 *
+	 * The default implementation copies the view into a SparseVector,
+	 * derived models override these to predict without copying.
+	 */
+	virtual Prediction predict(const SparseVectorView &x) const;
+	virtual std::vector<double> decision_value(const SparseVectorView &x) const;
+
+	/**
+	 * Predictions using the buffers of ctx, results are stored in ctx.prediction and ctx.decision_values.
+	 *
+	 * The default implementations forward to the allocating overloads,
+	 * derived models override these to predict without allocating.
+	 */
+	virtual const Prediction& predict(PredictionContext& ctx, const SparseVectorView &x) const;
+	virtual const std::vector<double>& decision_value(PredictionContext& ctx, const SparseVectorView &x) const;
+
+	/**
+	 * Grows the buffers of ctx to the sizes needed for predictions with this model.
+	 */
+	virtual void reserve(PredictionContext& ctx) const;
+
 
 	virtual ~Model(){};
 
@@ -138,6 +189,15 @@ public:
 	virtual size_t num_outputs() const=0;
 	virtual ~BinaryModel();
 
+	/**
+	 * Returns the decision values for a block of test instances.
+	 *
+	 * Element i of the result equals decision_value(*batch[i]).
+	 * The default implementation handles instances one at a time,
+	 * derived models may override this to share work over the block.
+	 */
+	virtual std::vector<std::vector<double>> decision_values(const std::vector<const SparseVector*>& batch) const;
+
 	/**
 	 * Constructs a BinaryModel from the given stream.
 	 *
@@ -151,6 +211,14 @@ public:
 	static unique_ptr<BinaryModel> load(const string&fname);
 
 	virtual void serialize(std::ostream& os) const=0;
+
+	/**
+	 * Serializes in a binary format that is faster to load, if the model has one.
+	 *
+	 * deserialize() recognizes both formats. Defaults to serialize(), the stream should be opened in binary mode.
+	 */
+	virtual void serialize_binary(std::ostream& os) const;
+
 	friend std::ostream &operator<<(std::ostream &os, const BinaryModel &model);
 };
 
@@ -200,12 +268,20 @@ private:
 	SVMModel &operator=(const SVMModel &orig);
 	unsigned getStartOfClass(unsigned classidx) const;
 
+	/**
+	 * Computes the squared norms of all SVs.
+	 */
+	void computeSquares();
+
 protected:
 	const SVMEnsemble *ens;
 
 	// support vectors
 	SV_container SVs;
 
+	// squared norms of the support vectors
+	std::vector<double> squares;
+
 	// SV weights: alpha_i*y_i
 	Weights weights;
 
@@ -219,6 +295,11 @@ protected:
 	// kernel parameters
 	Kernel *kernel;
 
+	/**
+	 * Writes the kernel evaluations between all SVs and x into kernelevals.
+	 */
+	void kernel_evaluations(const SparseVectorView &x, std::vector<double> &kernelevals) const;
+
 	/**
 	 * Do predictions with cached kernel evaluations.
 	 */
@@ -254,6 +335,13 @@ public:
 	virtual std::vector<double> decision_value(const SparseVector &i) const override;
 	virtual std::vector<double> decision_value(const std::vector<double> &i) const override;
 
+	virtual Prediction predict(const SparseVectorView &x) const override;
+	virtual std::vector<double> decision_value(const SparseVectorView &x) const override;
+
+	virtual const Prediction& predict(PredictionContext& ctx, const SparseVectorView &x) const override;
+	virtual const std::vector<double>& decision_value(PredictionContext& ctx, const SparseVectorView &x) const override;
+	virtual void reserve(PredictionContext& ctx) const override;
+
 	virtual size_t num_outputs() const override;
 
 	/**
@@ -28,6 +28,7 @@
 #include "Models.hpp"
 #include "Ensemble.hpp"
 #include "BinaryWorkflow.hpp"
+#include "Approximation.hpp"
 #include "SelectiveFactory.hpp"
 
 /*************************************************************************************************/
@@ -48,6 +49,7 @@ void registerBinaryModels(){
 	BINARYMODEL_REGISTRATION(SVMModel)
 	BINARYMODEL_REGISTRATION(SVMEnsemble)
 	BINARYMODEL_REGISTRATION(BinaryWorkflow)
+	BINARYMODEL_REGISTRATION(ApproximateEnsemble)
 }
 
 /*************************************************************************************************/
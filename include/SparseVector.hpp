@@ -30,6 +30,7 @@
 #include <map>
 #include <vector>
 #include <iostream>
+#include <cstdint>
 
 /*************************************************************************************************/
 
@@ -45,6 +46,11 @@ namespace ensemble{
 
 /*************************************************************************************************/
 
+template <typename T>
+struct BasicSparseRow;
+class SparseVectorView;
+class TextScanner;
+
 /**
  * Sparse Vector Class
  */
@@ -70,6 +76,17 @@ public:
 	SparseVector(const SparseVector &v);
 	SparseVector(const svm_node* x);
 
+	/**
+	 * Copies a row of a SparseMatrix or SparseMatrixF.
+	 */
+	template <typename T>
+	explicit SparseVector(const BasicSparseRow<T>& row);
+
+	/**
+	 * Copies the nonzeros of a view.
+	 */
+	explicit SparseVector(const SparseVectorView& v);
+
 	SparseVector(SparseVector&& o);
 	SparseVector &operator=(const SparseVector &v)=default;
 	SparseVector &operator=(SparseVector&& v);
@@ -112,6 +129,11 @@ public:
 	bool operator!=(const SparseVector& other) const;
 	bool operator<(const SparseVector& other) const;
 
+	/**
+	 * Returns a hash of the content, equal SparseVectors have equal hashes.
+	 */
+	size_t hash() const;
+
 	friend std::ostream &operator<<(std::ostream &os, const SparseVector &v);
 
 	/**
@@ -122,6 +144,11 @@ public:
 	 */
 	static unique_ptr<SparseVector> read(std::istream &iss, bool csv=false);
 
+	/**
+	 * Reads the remainder of the scanner's current line and moves it to the next line.
+	 */
+	static unique_ptr<SparseVector> read(TextScanner &scanner, bool csv=false);
+
 	/**
 	 * Reads a SparseVector formatted in CSV from iss.
 	 *
@@ -151,6 +178,139 @@ public:
 
 /*************************************************************************************************/
 
+/**
+ * Read-only view of a single row of a BasicSparseMatrix.
+ */
+template <typename T>
+struct BasicSparseRow{
+	const unsigned* indices;
+	const T* values;
+	size_t nnz;
+};
+
+/**
+ * Sparse matrix in compressed sparse row (CSR) format, with values of type T.
+ *
+ * With T=float, nonzeros take 8 bytes (32-bit index and value, stored as separate arrays),
+ * half of a SparseVector's padded index-value pairs. Rows of a SparseMatrixF are accepted by
+ * InnerProduct(), squaredNorm() and Kernel::k_function(), and convert to SparseVector.
+ *
+ * Rows can only be appended and are immutable afterwards. The nonzeros of all rows
+ * are stored contiguously in one index and one value array, delimited by row offsets.
+ *
+ * Appending may invalidate previously obtained rows.
+ */
+template <typename T>
+class BasicSparseMatrix final{
+private:
+	std::vector<unsigned> indices;
+	std::vector<T> values;
+	std::vector<size_t> offsets;	// row i spans [offsets[i],offsets[i+1])
+
+public:
+	BasicSparseMatrix();
+
+	/**
+	 * Appends v as a new row and returns its row index. Values are converted to T.
+	 */
+	size_t append(const SparseVector& v);
+	size_t append(const SparseVector::SparseSV& v);
+
+	/**
+	 * Returns the amount of rows.
+	 */
+	size_t rows() const;
+
+	/**
+	 * Returns the total amount of nonzeros.
+	 */
+	size_t numNonzero() const;
+
+	BasicSparseRow<T> row(size_t idx) const;
+
+	/**
+	 * Returns the transpose of this matrix.
+	 *
+	 * Row j of the result holds (i, value) for every row i with a nonzero in column j.
+	 */
+	BasicSparseMatrix transpose() const;
+
+	/**
+	 * Reserves storage for the given amount of rows and nonzeros.
+	 */
+	void reserve(size_t rows, size_t nnz);
+	void clear();
+};
+
+typedef BasicSparseRow<double> SparseRow;
+typedef BasicSparseMatrix<double> SparseMatrix;
+
+// single precision variants, see SVMEnsemble::set_single_precision()
+typedef BasicSparseRow<float> SparseRowF;
+typedef BasicSparseMatrix<float> SparseMatrixF;
+
+// int8 variants, holding quantization levels, see SVMEnsemble::quantize()
+typedef BasicSparseRow<int8_t> SparseRow8;
+typedef BasicSparseMatrix<int8_t> SparseMatrix8;
+
+/*************************************************************************************************/
+
+/**
+ * Non-owning, read-only view of a sparse vector with ascending indices.
+ *
+ * A view wraps a SparseVector, a SparseMatrix row, a LibSVM svm_node array or separate
+ * index and value arrays without copying them. Indices and values are read with a stride,
+ * so both interleaved and separate layouts are supported.
+ *
+ * The viewed data must outlive the view.
+ */
+class SparseVectorView final{
+private:
+	const char *indexptr;
+	const char *valueptr;
+	size_t indexstride;
+	size_t valuestride;
+	size_t nnz;
+
+public:
+	SparseVectorView(const SparseVector& v);
+	SparseVectorView(const SparseRow& row);
+	SparseVectorView(const unsigned *indices, const double *values, size_t nnz);
+
+	/**
+	 * Views the nodes of x up to its terminating node (index -1).
+	 */
+	explicit SparseVectorView(const svm_node *x);
+
+	/**
+	 * Returns the amount of nonzero elements.
+	 */
+	size_t numNonzero() const{ return nnz; }
+
+	/**
+	 * Returns the index and value of the k-th nonzero element.
+	 */
+	unsigned index(size_t k) const{ return *reinterpret_cast<const unsigned*>(indexptr+k*indexstride); }
+	double value(size_t k) const{ return *reinterpret_cast<const double*>(valueptr+k*valuestride); }
+
+	/**
+	 * Returns the index of the last nonzero element.
+	 */
+	unsigned size() const{ return nnz ? index(nnz-1) : 0; }
+
+	/**
+	 * Returns the position of the first nonzero element with index >= idx.
+	 */
+	size_t lower_bound(unsigned idx) const;
+
+	/**
+	 * Gets the value at index idx.
+	 */
+	double operator[](unsigned idx) const;
+};
+
+/*************************************************************************************************/
+
 /**
  * Returns the inner product between x and y.
  */
@@ -161,6 +321,13 @@ double InnerProduct(const SparseVector &x, const SparseVector &y);
  */
 double InnerProduct(const vector<pair<unsigned,double> > &x, const SparseVector &y);
 
+/**
+ * Returns the inner product between x and y.
+ */
+double InnerProduct(const SparseVectorView &x, const SparseVectorView &y);
+double InnerProduct(const SparseRowF &x, const SparseVectorView &y);
+double InnerProduct(const SparseRow8 &x, const SparseVectorView &y);
+
 /**
  * Returns the inner product between x and y.
  */
@@ -205,6 +372,48 @@ void ElementWiseProduct(const vector<T> &x, const vector<T> &y, vector<T> &xy);
 
 double squaredNorm(const SparseVector &v);
 double squaredNorm(const vector<pair<unsigned,double> > &v);
+double squaredNorm(const SparseRow &v);
+double squaredNorm(const SparseRowF &v);
+double squaredNorm(const SparseVectorView &v);
+
+/**
+ * Returns the squared Euclidean distance between x and y.
+ */
+double squaredDistance(const SparseVector &x, const SparseVector &y);
+double squaredDistance(const SparseVectorView &x, const SparseVectorView &y);
+double squaredDistance(const SparseRowF &x, const SparseVectorView &y);
+
+/**
+ * Dense kernels on contiguous arrays of length n.
+ *
+ * These use the widest SIMD instruction set the CPU supports (SSE2, AVX2 or AVX-512),
+ * which is determined once at runtime.
+ */
+double InnerProduct(const double *x, const double *y, size_t n);
+double InnerProduct(const float *x, const double *y, size_t n);
+double InnerProduct(const int8_t *x, const double *y, size_t n);
+double squaredDistance(const double *x, const double *y, size_t n);
+double squaredNorm(const double *x, size_t n);
+
+/**
+ * Returns the name of the instruction set used by the dense kernels.
+ */
+const char* denseKernelISA();
+
+/**
+ * Elementwise exp and tanh of n values, in place, using the same instruction set as the dense kernels.
+ *
+ * By default exp is accurate to a few ulp and tanh is std::tanh. In fast mode, exp has a relative
+ * error below 1e-8 and tanh an absolute error below 1e-8. NaN is returned as is in both modes.
+ * The result for a value does not depend on its position or on n.
+ */
+void exponential(double *x, size_t n);
+void hyperbolicTangent(double *x, size_t n);
+
+/**
+ * Enables fast mode for exponential() and hyperbolicTangent(). Must not be changed during predictions.
+ */
+void setFastTranscendentals(bool fast);
 
 std::shared_ptr<SparseVector> linear_combination(const std::vector<std::shared_ptr<SparseVector>>& SVs, const std::vector<double>& coeff);
 
@@ -0,0 +1,173 @@
+/**
+ *  Copyright (C) 2013 KU Leuven
+ *
+ *  This file is part of EnsembleSVM.
+ *
+ *  EnsembleSVM is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published
+ *  by the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  EnsembleSVM is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with EnsembleSVM.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * WorkerTeam.hpp
+ *
+ *      Author: Marc Claesen
+ */
+
+#ifndef WORKERTEAM_HPP_
+#define WORKERTEAM_HPP_
+
+/*************************************************************************************************/
+
+#include "config.h"
+#ifdef HAVE_PTHREAD
+
+/*************************************************************************************************/
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <vector>
+
+/*************************************************************************************************/
+
+namespace ensemble{
+
+/*************************************************************************************************/
+
+/**
+ * Persistent threads that cooperate on a single task, split into parts.
+ *
+ * Unlike ThreadPool, which queues independent jobs, run() blocks until all parts
+ * of one task are done and the calling thread participates. Running a task
+ * allocates no memory, so it is suitable for latency-sensitive inner loops.
+ */
+class WorkerTeam final{
+private:
+	std::vector<std::thread> threads;
+
+	std::mutex mutex;
+	std::condition_variable start_cv;
+	std::condition_variable done_cv;
+
+	// serializes concurrent calls to run()
+	std::mutex run_mutex;
+
+	// current task, fun(task,part) processes one part
+	void (*fun)(void*, size_t)=nullptr;
+	void *task=nullptr;
+	size_t numparts=0;
+
+	std::atomic<size_t> nextpart{0};
+	std::atomic<size_t> remaining{0};
+
+	unsigned generation=0;	// incremented for every task
+	unsigned active=0;		// amount of workers processing a task
+	bool stop_=false;
+
+	/**
+	 * Processes parts until none are left.
+	 */
+	static void execute(void (*f)(void*, size_t), void *t, size_t n, std::atomic<size_t>& next, std::atomic<size_t>& left){
+		for(size_t part=next++;part<n;part=next++){
+			f(t,part);
+			--left;
+		}
+	}
+
+	void work(){
+		unsigned seen=0;
+		std::unique_lock<std::mutex> lock(mutex);
+		while(true){
+			start_cv.wait(lock,[&](){ return stop_ || generation!=seen; });
+			if(stop_) return;
+			seen=generation;
+
+			void (*f)(void*, size_t)=fun;
+			void *t=task;
+			size_t n=numparts;
+			++active;
+			lock.unlock();
+
+			execute(f,t,n,nextpart,remaining);
+
+			lock.lock();
+			if(--active==0) done_cv.notify_all();
+		}
+	}
+
+	template <typename F>
+	static void invoke(void *f, size_t part){
+		(*static_cast<F*>(f))(part);
+	}
+
+public:
+	/**
+	 * Creates a team of numthreads threads, including the thread that calls run().
+	 */
+	WorkerTeam(unsigned numthreads){
+		if(numthreads>1) threads.reserve(numthreads-1);
+		for(unsigned i=1;i<numthreads;++i)
+			threads.emplace_back(&WorkerTeam::work,this);
+	}
+
+	WorkerTeam(const WorkerTeam&)=delete;
+	WorkerTeam& operator=(const WorkerTeam&)=delete;
+
+	~WorkerTeam(){
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			stop_=true;
+		}
+		start_cv.notify_all();
+		for(auto& t: threads) t.join();
+	}
+
+	/**
+	 * Returns the amount of threads, including the calling thread.
+	 */
+	unsigned num_threads() const{ return threads.size()+1; }
+
+	/**
+	 * Calls f(part) for all parts in [0,parts) and returns when all calls are finished.
+	 */
+	template <typename F>
+	void run(F& f, size_t parts){
+		std::lock_guard<std::mutex> serial(run_mutex);
+		{
+			// workers that woke up late for a previous task must be done before it is replaced
+			std::unique_lock<std::mutex> lock(mutex);
+			done_cv.wait(lock,[&](){ return active==0; });
+			fun=&invoke<F>;
+			task=&f;
+			numparts=parts;
+			nextpart=0;
+			remaining=parts;
+			++generation;
+		}
+		start_cv.notify_all();
+
+		execute(&invoke<F>,&f,parts,nextpart,remaining);
+
+		std::unique_lock<std::mutex> lock(mutex);
+		done_cv.wait(lock,[&](){ return active==0 && remaining==0; });
+	}
+};
+
+/*************************************************************************************************/
+
+}  // ensemble namespace
+
+/*************************************************************************************************/
+
+#endif // HAVE_PTHREAD
+
+#endif /* WORKERTEAM_HPP_ */
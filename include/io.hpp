@@ -33,6 +33,10 @@
 #include <deque>
 #include <memory>
 #include <exception>
+#include <streambuf>
+#include <istream>
+#include <string>
+#include <vector>
 
 /*************************************************************************************************/
 
@@ -62,6 +66,127 @@ struct FileFormats{
 
 /*************************************************************************************************/
 
+/**
+ * Read-only content of a file, memory mapped if the platform supports it and read otherwise.
+ *
+ * The content remains valid for the lifetime of the MappedFile.
+ */
+class MappedFile final{
+private:
+	const char *content=nullptr;
+	size_t length=0;
+	bool mapped=false;
+	bool opened=false;
+	std::vector<char> buffer;	// used when the file is not mapped
+
+public:
+	explicit MappedFile(const std::string &fname);
+	MappedFile(const MappedFile&)=delete;
+	MappedFile& operator=(const MappedFile&)=delete;
+	~MappedFile();
+
+	bool is_open() const{ return opened; }
+	const char* data() const{ return content; }
+	size_t size() const{ return length; }
+};
+
+/**
+ * Input stream buffer over a contiguous block of memory, which is not copied.
+ *
+ * Readers that recognize the buffer (via dynamic_cast on std::istream::rdbuf()) can access
+ * the unread bytes in place through position() and remaining(), and consume them with skip().
+ */
+class MemoryStreamBuffer final : public std::streambuf{
+public:
+	MemoryStreamBuffer(const char *data, size_t size);
+
+	const char* position() const{ return gptr(); }
+	size_t remaining() const{ return egptr()-gptr(); }
+	void skip(size_t n);
+
+protected:
+	virtual pos_type seekoff(off_type off, std::ios_base::seekdir dir, std::ios_base::openmode which) override;
+	virtual pos_type seekpos(pos_type pos, std::ios_base::openmode which) override;
+};
+
+/**
+ * Single pass tokenizer for text, without string streams.
+ *
+ * If the stream is backed by a MemoryStreamBuffer (e.g. a MappedFile), lines are tokenized in place.
+ * Otherwise they are read one at a time into a buffer. Tokens are separated by blanks (spaces, tabs
+ * and carriage returns) and never span lines. Numbers are parsed as in the "C" locale.
+ *
+ * Every line that is started must be finished with next_line(), after which the stream
+ * can be read further by other means.
+ */
+class TextScanner final{
+private:
+	std::istream &is;
+	MemoryStreamBuffer *memory;
+	std::string buffer;			// current line, if the stream is not backed by memory
+	const char *cur=nullptr;	// unread part of the current line
+	const char *end=nullptr;
+	bool loaded=false;
+	bool exhausted=false;
+
+	/**
+	 * Makes the next line of the stream current, if there is no current line.
+	 */
+	void load(){ if(!loaded) load_line(); }
+	void load_line();
+
+public:
+	explicit TextScanner(std::istream &is);
+
+	/**
+	 * Returns true if the stream has no lines left.
+	 */
+	bool eof(){ load(); return exhausted; }
+
+	/**
+	 * Returns the next character of the current line without consuming it, or '\n' at its end.
+	 */
+	int peek(){ load(); return cur<end ? *cur : '\n'; }
+
+	/**
+	 * Skips blanks and occurrences of separator, returns true if the current line has more content.
+	 */
+	bool skip_blanks(char separator=' '){
+		load();
+		while(cur<end && (*cur==' ' || *cur=='\t' || *cur=='\r' || *cur==separator)) ++cur;
+		return cur<end;
+	}
+
+	/**
+	 * Consumes c if it is the next character.
+	 */
+	bool consume(char c){
+		load();
+		if(cur==end || *cur!=c) return false;
+		++cur;
+		return true;
+	}
+
+	/**
+	 * Consumes the remainder of the current line, including its end.
+	 */
+	void next_line();
+
+	/**
+	 * Reads the next token on the current line into w. Returns false if there is none.
+	 */
+	bool word(std::string &w);
+
+	/**
+	 * Reads the next number on the current line into v. Returns false without consuming
+	 * anything if the next token does not start with a number.
+	 */
+	bool number(unsigned &v);
+	bool number(double &v);
+};
+
+/*************************************************************************************************/
+
 /**
  * Reads individual misclassification penalties per training instance.
  *
@@ -168,6 +168,8 @@ typedef std::tuple<std::vector<double>, size_t> CtorTuple;
 	}
 	virtual ~Scale(){}
 
+	const std::vector<double>& getCoefficients() const{ return coeff_; }
+
 	static CtorTuple deserialize(std::istream& is, size_t num_inputs, size_t num_outputs){
 
 		if(!is) pipeline_error("Error reading Scale from input stream.");
@@ -325,6 +327,8 @@ typedef std::tuple<std::vector<double>, size_t> CtorTuple;
 		return impl::Offset(std::move(inputs),offsets,PipeBase::num_outputs());
 	}
 
+	const std::vector<double>& getOffsets() const{ return offsets; }
+
 	virtual ~Offset() = default;
 
 	static CtorTuple deserialize(std::istream& is, size_t num_inputs, size_t num_outputs){
@@ -796,6 +800,8 @@ public:
 
 	virtual ~Average() = default;
 
+	double getDivisor() const{ return divisor; }
+
 	static CtorTuple deserialize(std::istream& is, size_t num_inputs, size_t num_outputs){
 		double d;
 		std::string line;
@@ -387,9 +387,10 @@ namespace {
 template <typename T>
 struct BB_CRTP_helper;
 
+// inputs are forwarded as rvalue references, so blocks that only read them do not copy them
 template <class Res, class Arg, class Internal, template <class, class> class Derived>
 struct BB_CRTP_helper<Derived<Res(Arg),Internal>>{
-	Res operator()(const Derived<Res(Arg),Internal> *bb, typename Derived<Res(Arg),Internal>::PipeBase::argument_type inputs){
+	Res operator()(const Derived<Res(Arg),Internal> *bb, typename Derived<Res(Arg),Internal>::PipeBase::argument_type&& inputs){
 		typedef typename Internal::Result ThisArg;
 		ThisArg res(bb->internal()->Internal::operator()(std::move(inputs)));
 		if(bb->num_inputs()) assert(check_size<ThisArg>(res,bb->num_inputs())
@@ -400,7 +401,7 @@ struct BB_CRTP_helper<Derived<Res(Arg),Internal>>{
 
 template <class Res, class Arg, template <class, class> class Derived>
 struct BB_CRTP_helper<Derived<Res(Arg),nullptr_t>>{
-	Res operator()(const Derived<Res(Arg),nullptr_t> *bb, Arg inputs){
+	Res operator()(const Derived<Res(Arg),nullptr_t> *bb, Arg&& inputs){
 		if(bb->num_inputs()) assert(check_size<Arg>(inputs,bb->num_inputs())
 				&& "Unexpected number of inputs");
 		return bb->Derived<Res(Arg),nullptr_t>::process(std::move(inputs));
@@ -465,7 +466,7 @@ protected:
 public:
 	Res operator()(argument_type&& inputs) const override final{
 		BB_CRTP_helper<Derived<Res(Arg),Internal>> h;
-		return h(static_cast<const Derived<Res(Arg),Internal>*>(this),inputs);
+		return h(static_cast<const Derived<Res(Arg),Internal>*>(this),std::move(inputs));
 	}
 
 	std::unique_ptr<PipeBase> clone() const override final{
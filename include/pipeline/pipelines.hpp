@@ -177,6 +177,17 @@ struct deserializer<Res(Arg)>{
  */
 MULTISTAGEPIPELINE(MajorityVote,double,std::vector<double>)
 
+/**
+ * Explicit form of a MajorityVote pipeline, its output equals
+ * 		sum_i (input[i] > threshold[i] ? above[i] : below[i]) / divisor
+ */
+struct VotingScheme{
+	std::vector<double> threshold;
+	std::vector<double> above;
+	std::vector<double> below;
+	double divisor;
+};
+
 template <>
 struct Factory<MajorityVote>{
 	MULTISTAGEPIPELINE_FACTORY_TYPEDEFS(MajorityVote)
@@ -238,12 +249,76 @@ struct Factory<MajorityVote>{
 		Vector tmp(coeffs);
 		return operator()(std::move(tmp),threshold);
 	}
+
+	/**
+	 * Retrieves the explicit voting scheme of pipe for the given number of inputs.
+	 *
+	 * Returns false if pipe is not a MajorityVote.
+	 */
+	static bool scheme(const MultistagePipe<Res(Arg)>& pipe, size_t numinputs, VotingScheme& scheme){
+		typedef Threshold<Vector(Vector)> ThresholdBlock;
+		typedef Scale<Vector(Vector),ThresholdBlock> ScaleBlock;
+		typedef Average<double(Vector),ScaleBlock> AverageBlock;
+
+		const MajorityVote* vote=dynamic_cast<const MajorityVote*>(&pipe);
+		if(!vote) return false;
+		const AverageBlock* avg=dynamic_cast<const AverageBlock*>(vote->pipe.get());
+		if(!avg) return false;
+
+		const std::vector<double>& coeffs=avg->internal()->getCoefficients();
+		const ThresholdBlock::Scheme& thresh=avg->internal()->internal()->getScheme();
+		scheme.divisor = avg->getDivisor() ? avg->getDivisor() : numinputs;
+		scheme.threshold.resize(numinputs);
+		scheme.above.resize(numinputs);
+		scheme.below.resize(numinputs);
+		for(size_t i=0;i<numinputs;++i){
+			size_t t = thresh.threshold.size()==1 ? 0 : i;
+			double c = coeffs.size()==1 ? coeffs[0] : coeffs[i];
+			scheme.threshold[i]=thresh.threshold[t];
+			scheme.above[i]=thresh.above[t]*c;
+			scheme.below[i]=thresh.below[t]*c;
+		}
+		return true;
+	}
 };
 
 //MULTISTAGEPIPELINE_POST_FACTORY(MajorityVote)
 
 /*************************************************************************************************/
 
+/**
+ * Explicit form of a linear aggregation, its output equals
+ * 		sum_i coeffs[i]*input[i] + offset
+ */
+struct LinearScheme{
+	std::vector<double> coeffs;
+	double offset;
+};
+
+namespace impl{
+
+/**
+ * Extracts the LinearScheme of an Offset(Sum(Scale)) pipeline.
+ * Returns false if pipe does not have this form.
+ */
+inline bool linear_scheme(const Pipeline<double(std::vector<double>)>* pipe, size_t numinputs, LinearScheme& scheme){
+	typedef std::vector<double> Vector;
+	typedef pipeline::Offset<double(double),pipeline::Sum<double(Vector),pipeline::Scale<Vector(Vector)>>> OffsetBlock;
+
+	const OffsetBlock* offset=dynamic_cast<const OffsetBlock*>(pipe);
+	if(!offset || offset->getOffsets().size()!=1) return false;
+
+	const std::vector<double>& coeffs=offset->internal()->internal()->getCoefficients();
+	if(coeffs.size()!=1 && coeffs.size()!=numinputs) return false;
+	scheme.coeffs.resize(numinputs);
+	for(size_t i=0;i<numinputs;++i)
+		scheme.coeffs[i] = coeffs.size()==1 ? coeffs[0] : coeffs[i];
+	scheme.offset=offset->getOffsets()[0];
+	return true;
+}
+
+} // ensemble::pipeline::impl namespace
+
 /**
  * Logistic regression pipeline.
  * Input: std::vector<double>
@@ -308,6 +383,21 @@ struct Factory<LogisticRegression>{
 		auto logistic = f_logistic(std::move(off));
 		return std::unique_ptr<LogisticRegression>(new LogisticRegression(std::move(logistic)));
 	}
+
+	/**
+	 * Fills scheme with the explicit form of pipe's argument to the logistic function.
+	 * Returns false if pipe is not a LogisticRegression.
+	 */
+	static bool scheme(const MultistagePipe<Res(Arg)>& pipe, size_t numinputs, LinearScheme& scheme){
+		typedef Offset<double(double),Sum<double(Vector),Scale<Vector(Vector)>>> OffsetBlock;
+		typedef Logistic<double(double),OffsetBlock> LogisticBlock;
+
+		const LogisticRegression* lr=dynamic_cast<const LogisticRegression*>(&pipe);
+		if(!lr) return false;
+		const LogisticBlock* logistic=dynamic_cast<const LogisticBlock*>(lr->pipe.get());
+		if(!logistic) return false;
+		return impl::linear_scheme(logistic->internal(),numinputs,scheme);
+	}
 };
 
 //MULTISTAGEPIPELINE_POST_FACTORY(LogisticRegression)
@@ -430,6 +520,16 @@ struct Factory<LinearAggregation>{
 
 		return std::unique_ptr<LinearAggregation>(new LinearAggregation(std::move(off)));
 	}
+
+	/**
+	 * Fills scheme with the explicit form of pipe.
+	 * Returns false if pipe is not a LinearAggregation.
+	 */
+	static bool scheme(const MultistagePipe<Res(Arg)>& pipe, size_t numinputs, LinearScheme& scheme){
+		const LinearAggregation* agg=dynamic_cast<const LinearAggregation*>(&pipe);
+		if(!agg) return false;
+		return impl::linear_scheme(agg->pipe.get(),numinputs,scheme);
+	}
 };
 
 //MULTISTAGEPIPELINE_POST_FACTORY(LinearAggregation)
@@ -0,0 +1,439 @@
+/**
+ *  Copyright (C) 2013 KU Leuven
+ *
+ *  This file is part of EnsembleSVM.
+ *
+ *  EnsembleSVM is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published
+ *  by the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  EnsembleSVM is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with EnsembleSVM.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Approximation.cpp
+ *
+ *      Author: Marc Claesen
+ */
+
+#include "Approximation.hpp"
+#include "Util.hpp"
+#include <cassert>
+#include <cmath>
+#include <random>
+#include <numeric>
+#include <algorithm>
+#include <sstream>
+#include <string>
+
+/*************************************************************************************************/
+
+namespace{
+
+std::streamsize PRECISION = 16;
+
+const double PI = 3.14159265358979323846;
+
+// relative regularization of the landmark kernel matrix, increased until it is positive definite
+const double NYSTROEM_JITTER = 1e-10;
+
+/**
+ * Reads a line of the form "<keyword> <value>" and returns value.
+ */
+template <typename T>
+T readKeyValue(std::istream& is, const std::string& keyword){
+	std::string line, key;
+	getline(is,line);
+	std::istringstream ss(line);
+	ss >> key;
+	if(key.compare(keyword)!=0)
+		exit_with_err(std::string("Invalid approximate model: expecting ") + keyword + ", got: " + line);
+	T value;
+	ss >> value;
+	return value;
+}
+
+/**
+ * Reads a line containing exactly n numbers into values.
+ */
+void readLine(std::istream& is, size_t n, double* values){
+	std::string line;
+	getline(is,line);
+	std::istringstream ss(line);
+	for(size_t i=0;i<n;++i){
+		if(!(ss >> values[i]))
+			exit_with_err("Invalid approximate model: line contains too few values.");
+	}
+}
+
+void writeLine(std::ostream& os, size_t n, const double* values){
+	for(size_t i=0;i<n;++i){
+		if(i) os << " ";
+		os << values[i];
+	}
+	os << std::endl;
+}
+
+/**
+ * Computes the lower triangular Cholesky factor of the symmetric n x n matrix K.
+ *
+ * Diagonal jitter is added until the factorization succeeds, to cope with (near) duplicate landmarks.
+ */
+std::vector<double> choleskyFactor(const std::vector<double>& K, size_t n){
+	double scale=0.0;
+	for(size_t i=0;i<n;++i) scale=std::max(scale,K[i*n+i]);
+	if(scale<=0.0) scale=1.0;
+
+	std::vector<double> L(n*n,0.0);
+	for(double jitter=NYSTROEM_JITTER*scale;;jitter*=10){
+		bool success=true;
+		std::fill(L.begin(),L.end(),0.0);
+		for(size_t j=0;success && j<n;++j){
+			double d=K[j*n+j]+jitter-InnerProduct(&L[j*n],&L[j*n],j);
+			if(d<=0.0){
+				success=false;
+				break;
+			}
+			L[j*n+j]=std::sqrt(d);
+			for(size_t i=j+1;i<n;++i)
+				L[i*n+j]=(K[i*n+j]-InnerProduct(&L[i*n],&L[j*n],j))/L[j*n+j];
+		}
+		if(success) return L;
+	}
+}
+
+/**
+ * Builds the ApproximateEnsemble of ens with given feature map.
+ */
+unique_ptr<ApproximateEnsemble> approximate(const SVMEnsemble& ens, unique_ptr<FeatureMap> map){
+	size_t D=map->dimension();
+
+	// base models using each distinct SV, along with their dual coefficients
+	std::vector<std::vector<std::pair<size_t,double>>> users(ens.numDistinctSV());
+	std::vector<double> rhos;
+	rhos.reserve(ens.size());
+	size_t modelidx=0;
+	for(SVMEnsemble::const_iterator I=ens.begin(),E=ens.end();I!=E;++I,++modelidx){
+		const SVMModel* model=I->first;
+		rhos.push_back(model->getConstant(0));
+		SVMModel::const_weight_iter Iw=model->weight_begin();
+		for(unsigned k=0;k<model->size();++k,++Iw)
+			users[ens.getSVindex(k,model)].push_back(std::make_pair(modelidx,*Iw));
+	}
+
+	// weights_i = sum_k alpha_ik * features(sv_k), each SV is mapped once
+	std::vector<double> weights(ens.size()*D,0.0);
+	size_t svidx=0;
+	for(SVMEnsemble::sv_const_iterator I=ens.sv_begin(),E=ens.sv_end();I!=E;++I,++svidx){
+		if(users[svidx].empty()) continue;
+		std::vector<double> z=map->features(**I);
+		for(auto& user: users[svidx]){
+			double* w=&weights[user.first*D];
+			for(size_t j=0;j<D;++j)
+				w[j]+=user.second*z[j];
+		}
+	}
+
+	return unique_ptr<ApproximateEnsemble>(new ApproximateEnsemble(std::move(map),std::move(weights),
+			std::move(rhos),ens.positive_label(),ens.negative_label()));
+}
+
+} // anonymous namespace
+
+/*************************************************************************************************/
+
+namespace ensemble{
+
+/*************************************************************************************************/
+
+unique_ptr<FeatureMap> FeatureMap::read(std::istream& is){
+	std::string line;
+	getline(is,line);
+	if(line.compare(RandomFourierFeatures::NAME)==0)
+		return unique_ptr<FeatureMap>(RandomFourierFeatures::read(is).release());
+	if(line.compare(NystroemFeatures::NAME)==0)
+		return unique_ptr<FeatureMap>(NystroemFeatures::read(is).release());
+	exit_with_err(std::string("Unknown feature map: ") + line);
+	return unique_ptr<FeatureMap>(nullptr);
+}
+
+/*************************************************************************************************/
+
+RandomFourierFeatures::RandomFourierFeatures(double gamma, size_t numinputs, size_t D, unsigned seed)
+:gamma(gamma),
+ numinputs(numinputs),
+ frequencies(numinputs*D),
+ offsets(D)
+{
+	// the spectral density of exp(-gamma*|u-v|^2) is Gaussian with variance 2*gamma
+	std::mt19937 rng(seed);
+	std::normal_distribution<double> frequency(0.0,std::sqrt(2*gamma));
+	std::uniform_real_distribution<double> offset(0.0,2*PI);
+	for(auto& w: frequencies) w=frequency(rng);
+	for(auto& b: offsets) b=offset(rng);
+}
+RandomFourierFeatures::RandomFourierFeatures(double gamma, size_t numinputs,
+		std::vector<double>&& frequencies, std::vector<double>&& offsets)
+:gamma(gamma),
+ numinputs(numinputs),
+ frequencies(std::move(frequencies)),
+ offsets(std::move(offsets))
+{
+	assert(this->frequencies.size()==numinputs*this->offsets.size() && "Invalid amount of frequencies!");
+}
+
+size_t RandomFourierFeatures::dimension() const{ return offsets.size(); }
+
+void RandomFourierFeatures::transform(const SparseVector& x, std::vector<double>& z) const{
+	size_t D=dimension();
+	assert(z.size()==D && "Invalid output vector supplied!");
+
+	std::copy(offsets.begin(),offsets.end(),z.begin());
+	double tail=0.0;
+	for(SparseVector::const_iterator I=x.begin(),E=x.end();I!=E;++I){
+		if(I->first > numinputs){
+			tail+=I->second*I->second;
+			continue;
+		}
+		const double* w=&frequencies[(I->first-1)*D];
+		for(size_t j=0;j<D;++j)
+			z[j]+=w[j]*I->second;
+	}
+
+	// SVs are zero beyond numinputs, so the remaining features scale all kernel evaluations
+	double scale=std::sqrt(2.0/D)*std::exp(-gamma*tail);
+	for(size_t j=0;j<D;++j)
+		z[j]=scale*std::cos(z[j]);
+}
+
+std::vector<double> RandomFourierFeatures::features(const SparseVector& sv) const{
+	std::vector<double> z(dimension(),0.0);
+	transform(sv,z);
+	return z;
+}
+
+void RandomFourierFeatures::serialize(std::ostream& os) const{
+	os.precision(PRECISION);
+	os << NAME << std::endl;
+	os << "gamma " << gamma << std::endl;
+	os << "num_inputs " << numinputs << std::endl;
+	os << "dimension " << dimension() << std::endl;
+	writeLine(os,offsets.size(),offsets.data());
+	for(size_t f=0;f<numinputs;++f)
+		writeLine(os,dimension(),&frequencies[f*dimension()]);
+}
+
+unique_ptr<RandomFourierFeatures> RandomFourierFeatures::read(std::istream& is){
+	double gamma=readKeyValue<double>(is,"gamma");
+	size_t numinputs=readKeyValue<size_t>(is,"num_inputs");
+	size_t D=readKeyValue<size_t>(is,"dimension");
+
+	std::vector<double> offsets(D), frequencies(numinputs*D);
+	readLine(is,D,offsets.data());
+	for(size_t f=0;f<numinputs;++f)
+		readLine(is,D,&frequencies[f*D]);
+
+	return unique_ptr<RandomFourierFeatures>(
+			new RandomFourierFeatures(gamma,numinputs,std::move(frequencies),std::move(offsets)));
+}
+
+/*************************************************************************************************/
+
+NystroemFeatures::NystroemFeatures(unique_ptr<Kernel> kernel, std::vector<SparseVector>&& landmarks)
+:kernel(std::move(kernel)),
+ landmarks(std::move(landmarks))
+{
+	size_t D=dimension();
+	squares.reserve(D);
+	for(auto& l: this->landmarks)
+		squares.push_back(squaredNorm(l));
+
+	std::vector<double> K(D*D,0.0);
+	for(size_t i=0;i<D;++i){
+		std::vector<double> row(D,0.0);
+		transform(this->landmarks[i],row);
+		std::copy(row.begin(),row.end(),K.begin()+i*D);
+	}
+	cholesky=choleskyFactor(K,D);
+}
+
+size_t NystroemFeatures::dimension() const{ return landmarks.size(); }
+
+void NystroemFeatures::transform(const SparseVector& x, std::vector<double>& z) const{
+	assert(z.size()==dimension() && "Invalid output vector supplied!");
+	if(kernel->isInnerProductBased()){
+		double xsquare=squaredNorm(x);
+		for(size_t j=0,D=dimension();j<D;++j)
+			z[j]=kernel->k_function(InnerProduct(landmarks[j],x),squares[j],xsquare);
+	}else{
+		for(size_t j=0,D=dimension();j<D;++j)
+			z[j]=kernel->k_function(&landmarks[j],&x);
+	}
+}
+
+std::vector<double> NystroemFeatures::features(const SparseVector& sv) const{
+	// solve L L' u = k(landmarks,sv) by forward and backward substitution
+	size_t D=dimension();
+	std::vector<double> u(D,0.0);
+	transform(sv,u);
+	for(size_t i=0;i<D;++i)
+		u[i]=(u[i]-InnerProduct(&cholesky[i*D],u.data(),i))/cholesky[i*D+i];
+	for(size_t i=D;i-->0;){
+		double sum=u[i];
+		for(size_t k=i+1;k<D;++k)
+			sum-=cholesky[k*D+i]*u[k];
+		u[i]=sum/cholesky[i*D+i];
+	}
+	return u;
+}
+
+void NystroemFeatures::serialize(std::ostream& os) const{
+	os.precision(PRECISION);
+	os << NAME << std::endl;
+	os << *kernel;
+	os << "num_landmarks " << dimension() << std::endl;
+	for(auto& l: landmarks)
+		os << l << std::endl;
+}
+
+unique_ptr<NystroemFeatures> NystroemFeatures::read(std::istream& is){
+	unique_ptr<Kernel> kernel=Kernel::read(is);
+	size_t D=readKeyValue<size_t>(is,"num_landmarks");
+
+	std::vector<SparseVector> landmarks;
+	landmarks.reserve(D);
+	for(size_t j=0;j<D;++j)
+		landmarks.push_back(*SparseVector::read(is));
+
+	return unique_ptr<NystroemFeatures>(new NystroemFeatures(std::move(kernel),std::move(landmarks)));
+}
+
+/*************************************************************************************************/
+
+ApproximateEnsemble::ApproximateEnsemble(unique_ptr<FeatureMap> map, std::vector<double>&& weights,
+		std::vector<double>&& rhos, const std::string& positive, const std::string& negative)
+:BinaryModel(),
+ map(std::move(map)),
+ weights(std::move(weights)),
+ rhos(std::move(rhos)),
+ positive(positive),
+ negative(negative)
+{
+	assert(this->weights.size()==this->rhos.size()*dimension() && "Invalid amount of weights!");
+}
+
+unique_ptr<ApproximateEnsemble> ApproximateEnsemble::fourier(const SVMEnsemble& ens, size_t D, unsigned seed){
+	const RBFKernel* rbf=dynamic_cast<const RBFKernel*>(ens.getKernel());
+	if(!rbf) exit_with_err("Random Fourier features require an RBF kernel.");
+
+	size_t numinputs=0;
+	for(SVMEnsemble::sv_const_iterator I=ens.sv_begin(),E=ens.sv_end();I!=E;++I)
+		numinputs=std::max<size_t>(numinputs,(*I)->size());
+
+	unique_ptr<FeatureMap> map(new RandomFourierFeatures(rbf->getGamma(),numinputs,D,seed));
+	return approximate(ens,std::move(map));
+}
+
+unique_ptr<ApproximateEnsemble> ApproximateEnsemble::nystroem(const SVMEnsemble& ens, size_t D, unsigned seed){
+	std::vector<size_t> indices(ens.numDistinctSV());
+	std::iota(indices.begin(),indices.end(),0);
+	std::mt19937 rng(seed);
+	std::shuffle(indices.begin(),indices.end(),rng);
+	indices.resize(std::min(D,indices.size()));
+
+	std::vector<SparseVector> landmarks;
+	landmarks.reserve(indices.size());
+	for(size_t idx: indices)
+		landmarks.push_back(*ens.getSV(idx));
+
+	unique_ptr<FeatureMap> map(new NystroemFeatures(ens.getKernel()->clone(),std::move(landmarks)));
+	return approximate(ens,std::move(map));
+}
+
+std::vector<double> ApproximateEnsemble::decision_value(const SparseVector &x) const{
+	size_t D=dimension();
+	std::vector<double> z(D,0.0);
+	map->transform(x,z);
+
+	std::vector<double> decision_vals(num_outputs(),0.0);
+	for(size_t i=0,n=decision_vals.size();i<n;++i)
+		decision_vals[i]=InnerProduct(&weights[i*D],z.data(),D)-rhos[i];
+	return decision_vals;
+}
+std::vector<double> ApproximateEnsemble::decision_value(const std::vector<double> &x) const{
+	return decision_value(SparseVector(x));
+}
+
+Prediction ApproximateEnsemble::predict(const SparseVector &x) const{
+	std::vector<double> decision_vals=decision_value(x);
+
+	Prediction pred(num_outputs()+1);
+	unsigned numpos = std::count_if(decision_vals.begin(),decision_vals.end(),
+			[](double decval){ return decval > 0; });
+	if(2*numpos > num_outputs()){
+		pred.setLabel(positive);
+		pred[0]=1.0*numpos/num_outputs();
+	}else{
+		pred[0]=1.0-1.0*numpos/num_outputs();
+		pred.setLabel(negative);
+	}
+	std::copy(decision_vals.begin(),decision_vals.end(),pred.begin()+1);
+	return pred;
+}
+Prediction ApproximateEnsemble::predict(const std::vector<double> &x) const{
+	return predict(SparseVector(x));
+}
+
+std::string ApproximateEnsemble::positive_label() const{ return positive; }
+std::string ApproximateEnsemble::negative_label() const{ return negative; }
+size_t ApproximateEnsemble::num_outputs() const{ return rhos.size(); }
+size_t ApproximateEnsemble::dimension() const{ return map->dimension(); }
+
+void ApproximateEnsemble::serialize(std::ostream& os) const{
+	os.precision(PRECISION);
+	os << NAME << std::endl;
+	os << "labels " << positive << " " << negative << std::endl;
+	os << "num_models " << num_outputs() << std::endl;
+	map->serialize(os);
+
+	// one line per base model: rho followed by its weights
+	os.precision(PRECISION);
+	for(size_t i=0;i<num_outputs();++i){
+		os << rhos[i] << " ";
+		writeLine(os,dimension(),&weights[i*dimension()]);
+	}
+}
+
+unique_ptr<BinaryModel> ApproximateEnsemble::deserialize(std::istream& is){
+	std::string line, key, positive, negative;
+	getline(is,line);
+	std::istringstream ss(line);
+	ss >> key >> positive >> negative;
+	if(key.compare("labels")!=0)
+		exit_with_err(std::string("Invalid approximate model: expecting labels, got: ") + line);
+
+	size_t nummodels=readKeyValue<size_t>(is,"num_models");
+	unique_ptr<FeatureMap> map=FeatureMap::read(is);
+
+	size_t D=map->dimension();
+	std::vector<double> weights(nummodels*D), rhos(nummodels), row(D+1);
+	for(size_t i=0;i<nummodels;++i){
+		readLine(is,D+1,row.data());
+		rhos[i]=row[0];
+		std::copy(row.begin()+1,row.end(),weights.begin()+i*D);
+	}
+
+	return unique_ptr<BinaryModel>(new ApproximateEnsemble(std::move(map),std::move(weights),
+			std::move(rhos),positive,negative));
+}
+
+/*************************************************************************************************/
+
+} // ensemble namespace
+
+/*************************************************************************************************/
@@ -24,6 +24,8 @@
 #include <algorithm>
 #include "BinaryWorkflow.hpp"
 #include "Util.hpp"
+#include <limits>
+#include <cmath>
 
 using namespace ensemble::pipeline;
 
@@ -69,6 +71,7 @@ BinaryWorkflow::BinaryWorkflow(	std::unique_ptr<Preprocessing> preprocess,
 	if(postprocessing.get() && postprocessing->num_inputs())
 		assert(postprocessing->num_inputs()==predictor->num_outputs()
 				&& "Number of post processing inputs does not match predictor outputs!");
+	update_votingscheme();
 }
 BinaryWorkflow::BinaryWorkflow(
 				std::unique_ptr<BinaryModel> pred,
@@ -86,6 +89,7 @@ BinaryWorkflow::BinaryWorkflow(
 	if(postprocessing.get() && postprocessing->num_inputs())
 		assert(postprocessing->num_inputs()==predictor->num_outputs()
 				&& "Number of post processing inputs does not match predictor outputs!");
+	update_votingscheme();
 }
 BinaryWorkflow::BinaryWorkflow(
 				std::unique_ptr<BinaryModel> pred,
@@ -117,15 +121,34 @@ void BinaryWorkflow::set_prediction(std::unique_ptr<BinaryModel> pipe){
 		assert(pipe->num_outputs() == postprocessing->num_inputs() &&
 			"Number of predictor outputs does not match number of postprocessing inputs!");
 	predictor.reset(pipe.release());
+	update_votingscheme();
 }
 void BinaryWorkflow::set_postprocessing(std::unique_ptr<Postprocessing> pipe){
 	if(pipe->num_inputs()) assert(pipe->num_inputs() == predictor->num_outputs() &&
 			"Number of predictor outputs does not match number of postprocessing inputs!");
 	postprocessing.reset(pipe.release());
+	update_votingscheme();
 }
 void BinaryWorkflow::set_threshold(double threshold){
 	this->threshold=threshold;
 }
+void BinaryWorkflow::update_votingscheme(){
+	majorityvote = postprocessing.get() && predictor.get() &&
+			Factory<MajorityVote>::scheme(*postprocessing,predictor->num_outputs(),votes) &&
+			votes.divisor > 0;
+	if(!majorityvote) return;
+
+	size_t n=votes.threshold.size();
+	maxRemaining.assign(n+1,0.0);
+	minRemaining.assign(n+1,0.0);
+	double total=0.0;
+	for(size_t i=n;i-->0;){
+		maxRemaining[i]=maxRemaining[i+1]+std::max(votes.above[i],votes.below[i]);
+		minRemaining[i]=minRemaining[i+1]+std::min(votes.above[i],votes.below[i]);
+		total+=std::max(std::abs(votes.above[i]),std::abs(votes.below[i]));
+	}
+	voteErrorBound=4*(n+1)*std::numeric_limits<double>::epsilon()*total;
+}
 size_t BinaryWorkflow::num_inputs() const{
 	if(preprocessing.get()) return preprocessing->num_inputs();
 	return 0;
@@ -136,6 +159,9 @@ size_t BinaryWorkflow::num_predictor_outputs() const{
 }
 
 Prediction BinaryWorkflow::predict(const SparseVector& v) const{
+	return predict(SparseVectorView(v));
+}
+Prediction BinaryWorkflow::predict(const SparseVectorView& v) const{
 	std::vector<double> decvals=decision_value(v);
 
 	if(decvals[0] > threshold)
@@ -147,17 +173,7 @@ Prediction BinaryWorkflow::predict(const std::vector<double> &i) const{
 	return predict(std::move(v));
 }
 
-std::vector<double> BinaryWorkflow::decision_value(const SparseVector &i) const{
-
-	Vector intermediate;
-	if(preprocessing.get()){
-		SparseVector icp(i); // todo inefficient
-		icp = Helper<Preprocessing>::eval(preprocessing,std::move(icp));
-		intermediate = predictor->decision_value(std::move(icp));
-	}else{
-		intermediate = predictor->decision_value(i);
-	}
-
+std::vector<double> BinaryWorkflow::postprocess(Vector&& intermediate) const{
 	Vector result(1,0.0);
 	result.reserve(intermediate.size()+1);
 	std::copy(intermediate.begin(),intermediate.end(),std::back_inserter(result));
@@ -171,6 +187,148 @@ std::vector<double> BinaryWorkflow::decision_value(const SparseVector &i) const{
 	}
 	return std::move(result);
 }
+double BinaryWorkflow::postprocess(PredictionContext& ctx, const Vector& intermediate) const{
+	if(majorityvote){
+		// the votes of MajorityVote, summed in the same order
+		double sum=0.0;
+		for(size_t i=0;i<intermediate.size();++i)
+			sum += intermediate[i] > votes.threshold[i] ? votes.above[i] : votes.below[i];
+		return sum/votes.divisor;
+	}
+
+	// blocks receive their input as an rvalue reference, so the buffer remains in ctx
+	// unless a block transforms the values in place
+	if(&intermediate!=&ctx.decision_values)
+		ctx.decision_values.assign(intermediate.begin(),intermediate.end());
+	return Helper<Postprocessing>::eval(postprocessing,std::move(ctx.decision_values));
+}
+std::vector<double> BinaryWorkflow::decision_value(const SparseVector &i) const{
+	return decision_value(SparseVectorView(i));
+}
+std::vector<double> BinaryWorkflow::decision_value(const SparseVectorView &i) const{
+	if(preprocessing.get()){
+		// preprocessing consumes its input, so this is the only copy
+		SparseVector icp(i);
+		icp = Helper<Preprocessing>::eval(preprocessing,std::move(icp));
+		return postprocess(predictor->decision_value(icp));
+	}
+	return postprocess(predictor->decision_value(i));
+}
+const Prediction& BinaryWorkflow::predict(PredictionContext& ctx, const SparseVectorView& v) const{
+	const std::vector<double>* intermediate;
+	if(preprocessing.get()){
+		SparseVector icp(v);
+		icp = Helper<Preprocessing>::eval(preprocessing,std::move(icp));
+		intermediate = &predictor->decision_value(ctx,icp);
+	}else{
+		intermediate = &predictor->decision_value(ctx,v);
+	}
+
+	// same layout as postprocess(): the aggregated value followed by the predictor's outputs
+	Prediction& pred=ctx.prediction;
+	pred.resize(intermediate->size()+1);
+	std::copy(intermediate->begin(),intermediate->end(),pred.begin()+1);
+	if(postprocessing.get())
+		pred[0] = postprocess(ctx,*intermediate);
+	else{
+		assert(predictor->num_outputs()==1 &&
+				"No postprocessing included even though aggregation is required.");
+		pred[0] = (*intermediate)[0];
+	}
+	pred.setLabel(pred[0] > threshold ? positive : negative);
+	return pred;
+}
+const std::vector<double>& BinaryWorkflow::decision_value(PredictionContext& ctx, const SparseVectorView &i) const{
+	const Prediction& pred=predict(ctx,i);
+	ctx.decision_values.assign(pred.begin(),pred.end());
+	return ctx.decision_values;
+}
+void BinaryWorkflow::reserve(PredictionContext& ctx) const{
+	predictor->reserve(ctx);
+	ctx.decision_values.reserve(predictor->num_outputs()+1);
+	ctx.prediction.resize(predictor->num_outputs()+1);
+}
+std::vector<std::vector<double>> BinaryWorkflow::decision_values(const std::vector<const SparseVector*>& batch) const{
+	std::vector<std::vector<double>> intermediate;
+	if(preprocessing.get()){
+		std::vector<SparseVector> preprocessed;
+		preprocessed.reserve(batch.size());
+		for(auto x: batch){
+			SparseVector icp(*x);
+			preprocessed.emplace_back(Helper<Preprocessing>::eval(preprocessing,std::move(icp)));
+		}
+		std::vector<const SparseVector*> ptrs;
+		ptrs.reserve(preprocessed.size());
+		for(auto& x: preprocessed)
+			ptrs.push_back(&x);
+		intermediate = predictor->decision_values(ptrs);
+	}else{
+		intermediate = predictor->decision_values(batch);
+	}
+
+	std::vector<std::vector<double>> result;
+	result.reserve(intermediate.size());
+	for(auto& decvals: intermediate)
+		result.emplace_back(postprocess(std::move(decvals)));
+	return result;
+}
+Prediction BinaryWorkflow::predict_label(const SparseVectorView& v) const{
+	const SVMEnsemble* ens=dynamic_cast<const SVMEnsemble*>(predictor.get());
+	if(!majorityvote || !ens)
+		return Prediction(predict(v).getLabel(),Prediction::ScoreCont());
+
+	SparseVector x(v);
+	if(preprocessing.get())
+		x = Helper<Preprocessing>::eval(preprocessing,std::move(x));
+
+	// votes are summed in the same order as MajorityVote does, early decisions require
+	// a margin that exceeds potential rounding differences
+	double sum=0.0, bound=threshold*votes.divisor;
+	double margin=voteErrorBound+4*std::numeric_limits<double>::epsilon()*std::abs(bound);
+	size_t last=votes.threshold.size()-1;
+	bool ispositive=false;
+	auto decided=[&](size_t i, double decval) -> bool{
+		sum += decval > votes.threshold[i] ? votes.above[i] : votes.below[i];
+		if(i==last){
+			ispositive = sum/votes.divisor > threshold;
+			return true;
+		}
+		if(sum+minRemaining[i+1] > bound+margin){
+			ispositive=true;
+			return true;
+		}
+		if(sum+maxRemaining[i+1] < bound-margin){
+			ispositive=false;
+			return true;
+		}
+		return false;
+	};
+	ens->lazy_decision_value(x,decided);
+
+	return Prediction(ispositive ? positive : negative,Prediction::ScoreCont());
+}
+bool BinaryWorkflow::fold_aggregation(){
+	const SVMEnsemble* ens=dynamic_cast<const SVMEnsemble*>(predictor.get());
+	if(!ens || !postprocessing.get()) return false;
+
+	LinearScheme scheme;
+	std::unique_ptr<Postprocessing> post;
+	if(Factory<LinearAggregation>::scheme(*postprocessing,ens->num_outputs(),scheme)){
+		Factory<LinearAggregation> f;
+		post.reset(f(std::vector<double>(1,1.0),0.0).release());
+	}else if(Factory<LogisticRegression>::scheme(*postprocessing,ens->num_outputs(),scheme)){
+		Factory<LogisticRegression> f;
+		post.reset(f(std::vector<double>(1,1.0),0.0).release());
+	}else{
+		return false;
+	}
+
+	std::unique_ptr<BinaryModel> model(ens->combine(scheme.coeffs,scheme.offset).release());
+	predictor=std::move(model);
+	postprocessing=std::move(post);
+	update_votingscheme();
+	return true;
+}
 std::vector<double> BinaryWorkflow::decision_value(const std::vector<double> &i) const{
 	SparseVector v(i);	// todo inefficient
 	return decision_value(std::move(v));
@@ -222,6 +380,22 @@ void BinaryWorkflow::serialize(std::ostream& os) const{
 	print_threshold(os);
 }
 
+void BinaryWorkflow::serialize_binary(std::ostream& os) const{
+	os << "BinaryWorkflow" << std::endl;
+
+	os << "preprocessing" << std::endl;
+	print_preprocessing(os);
+
+	os << "predictor" << std::endl;
+	predictor->serialize_binary(os);
+
+	os << "postprocessing" << std::endl;
+	print_postprocessing(os);
+
+	os << "threshold" << std::endl;
+	print_threshold(os);
+}
+
 std::ostream& operator<<(std::ostream& os, const BinaryWorkflow& flow){
 	flow.serialize(os);
 	return os;
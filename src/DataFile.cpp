@@ -101,12 +101,12 @@ unique_ptr<std::string> DataLine::getLabel(){ return std::move(label); }
 const SparseVector *DataLine::rawSV() const{ return sv.get(); }
 const std::string *DataLine::rawLabel() const{ return label.get(); }
 
-ConstDataLine::ConstDataLine(const std::string* lab, const SparseVector* vec)
+ConstDataLine::ConstDataLine(const std::string* lab, const SparseVectorView& vec)
 :label(lab),
  sv(vec),
  islabeled(true)
 {}
-ConstDataLine::ConstDataLine(const SparseVector* vec)
+ConstDataLine::ConstDataLine(const SparseVectorView& vec)
 :label(nullptr),
  sv(vec),
  islabeled(false)
@@ -119,14 +119,17 @@ ConstDataLine::ConstDataLine(ConstDataLine&& o)
 ConstDataLine::~ConstDataLine(){}
 
 bool ConstDataLine::labeled() const{ return islabeled; }
-const SparseVector *ConstDataLine::rawSV() const{ return sv; }
+const SparseVectorView& ConstDataLine::rawView() const{ return sv; }
 const std::string *ConstDataLine::rawLabel() const{ return label; }
 
-DataFile::DataFile(){}
-unsigned DataFile::size() const{ return instances.size(); }
+DataFile::DataFile(bool packed):packed(packed){}
+unsigned DataFile::size() const{
+	if(packed) return packedInstances.rows();
+	return instances.size();
+}
 
 DataFile::~DataFile(){}
-DataFile::DataFile(const string &fname){
+DataFile::DataFile(const string &fname):packed(false){
 	istringstream liness;
 	std::ifstream file;
 	string line, junk;
@@ -150,12 +153,22 @@ DataFile::DataFile(const string &fname){
 	file.close();
 }
 
-const SparseVector *DataFile::operator[](unsigned idx) const{ return instances.at(idx).get(); }
+void DataFile::add(unique_ptr<SparseVector> sv){
+	if(packed) packedInstances.append(*sv);
+	else instances.emplace_back(std::move(sv));
+}
+
+SparseVectorView DataFile::operator[](unsigned idx) const{
+	if(!packed) return SparseVectorView(*instances.at(idx));
+	if(idx>=packedInstances.rows())
+		exit_with_err("Invalid instance index when reading packed DataFile.");
+	return SparseVectorView(packedInstances.row(idx));
+}
 std::shared_ptr<ConstDataLine> DataFile::getdataline(unsigned idx) const{
 	return std::make_shared<ConstDataLine>(operator[](idx));
 }
 
-LabeledDataFile::LabeledDataFile():DataFile(){}
+LabeledDataFile::LabeledDataFile(bool packed):DataFile(packed){}
 
 const LabeledDataFile::Label *LabeledDataFile::getLabel(unsigned instance) const{
 	return labelmap.at(instance).second;
@@ -183,22 +196,22 @@ const LabeledDataFile::Label *LabeledDataFile::addLabel(unique_ptr<Label> label)
 /**
  * Data file reading
  */
-unique_ptr<DataFile> DataFile::readf(const std::string &fname, int format){
+unique_ptr<DataFile> DataFile::readf(const std::string &fname, int format, bool packed){
 	std::ifstream file(fname.c_str(),std::ios::in);
 
-	unique_ptr<DataFile> datafile(DataFile::readf(file,format));
+	unique_ptr<DataFile> datafile(DataFile::readf(file,format,packed));
 	file.close();
 	return datafile;
 }
 
 
-unique_ptr<DataFile> DataFile::readf(std::istream &iss, int format){
-	unique_ptr<DataFile> datafile(new DataFile());
+unique_ptr<DataFile> DataFile::readf(std::istream &iss, int format, bool packed){
+	unique_ptr<DataFile> datafile(new DataFile(packed));
 
 	string line;
 	while(getline(iss,line)){
 		unique_ptr<DataLine> dataline(DataFile::readline(line,format));
-		datafile->instances.emplace_back(dataline->getSV());
+		datafile->add(dataline->getSV());
 	}
 	return datafile;
 }
@@ -219,16 +232,18 @@ unique_ptr<DataLine> DataFile::readline(const std::string &line, int format){
 	return unique_ptr<DataLine>(new DataLine(std::move(sv)));
 }
 
-unique_ptr<LabeledDataFile> LabeledDataFile::readf(const std::string &fname, int format, const std::deque<unsigned> *indices){
+unique_ptr<LabeledDataFile> LabeledDataFile::readf(const std::string &fname, int format, const std::deque<unsigned> *indices,
+		bool packed){
 	std::ifstream file(fname.c_str(),std::ios::in);
 
-	unique_ptr<LabeledDataFile> datafile(LabeledDataFile::readf(file,format,indices));
+	unique_ptr<LabeledDataFile> datafile(LabeledDataFile::readf(file,format,indices,packed));
 	file.close();
 	return datafile;
 }
 
-unique_ptr<LabeledDataFile> LabeledDataFile::readf(std::istream &iss, int format, const std::deque<unsigned> *indices){
-	unique_ptr<LabeledDataFile> datafile(new LabeledDataFile());
+unique_ptr<LabeledDataFile> LabeledDataFile::readf(std::istream &iss, int format, const std::deque<unsigned> *indices,
+		bool packed){
+	unique_ptr<LabeledDataFile> datafile(new LabeledDataFile(packed));
 
 	std::deque<unsigned> sortedindices;
 	std::deque<unsigned>::const_iterator Iind;
@@ -252,9 +267,9 @@ unique_ptr<LabeledDataFile> LabeledDataFile::readf(std::istream &iss, int format
 			unique_ptr<DataLine> dataline(LabeledDataFile::readline(line,format));
 			unique_ptr<SparseVector> sv=dataline->getSV();
 			unique_ptr<Label> label=dataline->getLabel();
-			const SparseVector* ptr=sv.get();
+			const SparseVector* ptr=packed ? nullptr : sv.get();
 
-			datafile->instances.emplace_back(std::move(sv));
+			datafile->add(std::move(sv));
 			const Label *thislabel=datafile->addLabel(std::move(label));
 			datafile->labelmap.push_back(std::make_pair(ptr,thislabel));
 
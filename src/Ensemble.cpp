@@ -27,7 +27,9 @@
 #include "Util.hpp"
 #include "io.hpp"
 #include "config.h"
+#include "WorkerTeam.hpp"
 #include <set>
+#include <unordered_map>
 #include <cassert>
 #include <algorithm>
 #include <iostream>
@@ -35,6 +37,18 @@
 #include <string>
 #include <fstream>
 #include <memory>
+#include <numeric>
+#include <random>
+#include <type_traits>
+#include <cmath>
+#include <limits>
+#include <cstdint>
+#include <cstring>
+#ifdef HAVE_PTHREAD
+#include <atomic>
+#include <mutex>
+#include <thread>
+#endif
 
 using std::unique_ptr;
 
@@ -43,6 +57,219 @@ namespace{
 
 std::streamsize PRECISION = 16;
 
+// tile dimensions used in batch predictions: SVs x instances
+const size_t SV_TILE_SIZE = 256;
+const size_t INSTANCE_TILE_SIZE = 32;
+
+// inverted feature index is used for ensembles with lower SV density than this
+const double FEATURE_INDEX_DENSITY = 0.05;
+
+// single predictions are split over threads for at least this many distinct SVs or total SVs
+const size_t PARALLEL_THRESHOLD = 16384;
+
+// ranges per thread when splitting a prediction, more ranges balance the load better
+const size_t RANGES_PER_THREAD = 4;
+
+// distinct SVs with at least this fraction of nonzeros between their first and last nonzero
+// are additionally stored as dense segments
+const double DENSE_SV_DENSITY = 0.5;
+
+// dense segments start at multiples of this many elements, i.e. a cache line of doubles
+const size_t SEGMENT_ALIGNMENT = 8;
+
+// if all distinct SVs are dense and their segments fill at least this fraction of a matrix over
+// all features, the segments are laid out as one row-major matrix, see SVMEnsembleImpl::layout_dense()
+const double DENSE_MATRIX_DENSITY = 0.5;
+
+// alignment of the rows of the dense SV matrix, in bytes
+const size_t DENSE_ALIGNMENT = 64;
+
+/**
+ * Binary ensemble format, see SVMEnsembleImpl::serialize_binary().
+ *
+ * The payload starts with HEADER_WORDS words, followed by an (offset,size) pair in bytes per section.
+ * Offsets are relative to the payload and aligned to BINARY_ALIGNMENT, arrays are in native byte order.
+ *
+ * Version 1 lacks the FEATURE_* sections and stores SV_INDICES as uint32_t and SV_VALUES as double.
+ * Version 2 lacks SV_INDEX_OFFSETS.
+ */
+const unsigned BINARY_VERSION = 3;
+const uint64_t BINARY_MAGIC = 0x4d56534c424d5345ull;	// detects a different byte order
+const size_t BINARY_ALIGNMENT = 8;
+
+enum BinaryHeader{ MAGIC, FLAGS, NUM_SV, NUM_NONZERO, NUM_MODELS, HEADER_WORDS };
+enum BinarySection{
+	TEXT,				// kernel, label map and one line of classes per model
+	SV_OFFSETS,			// uint64_t, distinct SV i spans [offsets[i],offsets[i+1]) of the nonzeros
+	SV_INDICES,			// per SV, differences between consecutive feature indices as variable length integers
+	SV_VALUES,			// double, float, uint16_t (half) or int8_t, see VALUE_ENCODING_SHIFT
+	MODEL_OFFSETS,		// uint64_t, model i spans [offsets[i],offsets[i+1]) of MODEL_SVS
+	MODEL_SVS,			// uint32_t, distinct SV indices
+	MODEL_WEIGHTS,		// double, numSV*(k-1) per model
+	MODEL_CONSTANTS,	// double, k*(k-1)/2 per model
+	FEATURE_INDICES,	// uint32_t, features that occur in the SVs, only for int8 values
+	FEATURE_SCALES,		// double, scale of each of the FEATURE_INDICES
+	SV_INDEX_OFFSETS,	// uint64_t, distinct SV i starts at byte offsets[i] of SV_INDICES
+	NUM_SECTIONS
+};
+const uint64_t SINGLE_PRECISION_FLAG = 1;
+const unsigned VALUE_ENCODING_SHIFT = 8;	// bits 8-15 of the flags hold the SVMEnsemble::ValueEncoding
+
+uint64_t binary_align(uint64_t size){
+	return (size+BINARY_ALIGNMENT-1)/BINARY_ALIGNMENT*BINARY_ALIGNMENT;
+}
+
+/**
+ * Returns the array of <count> elements stored in section <idx> of a binary ensemble.
+ */
+template <typename T>
+const T* binary_section(const char *payload, const uint64_t *header, unsigned idx, uint64_t count){
+	uint64_t size=header[HEADER_WORDS+2*idx+1];
+	if(count>size/sizeof(T) || size!=count*sizeof(T))
+		ensemble::exit_with_err("Invalid binary ensemble SVM model: section has an invalid size.");
+	return reinterpret_cast<const T*>(payload+header[HEADER_WORDS+2*idx]);
+}
+
+/**
+ * Appends value to bytes in 7 bit groups, least significant first, the high bit marks continuation.
+ */
+void write_varint(std::vector<uint8_t>& bytes, uint32_t value){
+	for(;value>=0x80;value>>=7)
+		bytes.push_back(static_cast<uint8_t>(value|0x80));
+	bytes.push_back(static_cast<uint8_t>(value));
+}
+
+/**
+ * Reads a value written by write_varint() at pos and advances pos, returns false if it exceeds end.
+ */
+bool read_varint(const uint8_t *&pos, const uint8_t *end, uint32_t& value){
+	value=0;
+	for(unsigned shift=0;pos!=end && shift<32;shift+=7){
+		uint8_t byte=*pos++;
+		value|=uint32_t(byte&0x7f)<<shift;
+		if(!(byte&0x80)) return true;
+	}
+	return false;
+}
+
+const double HALF_MAX = 65504.0;
+const double INT8_MAX_LEVEL = 127.0;
+
+/**
+ * Converts to IEEE half precision, rounding to nearest even and clamping to HALF_MAX.
+ */
+uint16_t to_half(double value){
+	uint16_t sign = std::signbit(value) ? 0x8000 : 0;
+	double magnitude=std::min(std::abs(value),HALF_MAX);
+	if(std::isnan(value)) return 0x7e00;
+
+	// subnormals are multiples of 2^-24, rounding up to 2^10 of them yields the smallest normal
+	if(magnitude<std::ldexp(1.0,-14))
+		return sign | static_cast<uint16_t>(std::nearbyint(std::ldexp(magnitude,24)));
+
+	int exponent;
+	double fraction=std::frexp(magnitude,&exponent);	// magnitude = fraction*2^exponent, fraction in [0.5,1)
+	unsigned mantissa=std::nearbyint(std::ldexp(fraction,11));
+	unsigned biased=exponent+14;
+	if(mantissa==2048){
+		mantissa=1024;
+		++biased;
+	}
+	return sign | biased<<10 | (mantissa-1024);
+}
+
+double from_half(uint16_t half){
+	unsigned biased=(half>>10)&0x1f, mantissa=half&0x3ff;
+	double magnitude;
+	if(biased==0) magnitude=std::ldexp(mantissa,-24);
+	else if(biased==31) magnitude = mantissa ? NAN : INFINITY;
+	else magnitude=std::ldexp(1024+mantissa,biased-25);
+	return half&0x8000 ? -magnitude : magnitude;
+}
+
+int8_t to_int8(double value, double scale){
+	if(scale==0.0) return 0;
+	return static_cast<int8_t>(std::max(-INT8_MAX_LEVEL,std::min(INT8_MAX_LEVEL,std::round(value/scale))));
+}
+
+/**
+ * Returns value as it is stored in <encoding>, scale is the feature's scale for int8 values.
+ */
+double quantize_value(double value, ensemble::SVMEnsemble::ValueEncoding encoding, double scale){
+	switch(encoding){
+	case ensemble::SVMEnsemble::FLOAT_VALUES: return static_cast<float>(value);
+	case ensemble::SVMEnsemble::HALF_VALUES: return from_half(to_half(value));
+	case ensemble::SVMEnsemble::INT8_VALUES: return to_int8(value,scale)*scale;
+	default: return value;
+	}
+}
+
+const char* ENCODING_NAMES[] = { "double", "float", "half", "int8" };
+
+/**
+ * Writes rounded SV values in the format of SparseVector, with enough digits to read them back exactly.
+ *
+ * Values read back must round to themselves again, which they would not with the usual precision.
+ */
+void write_rounded(std::ostream& os, const SparseVector::SparseSV& sv){
+	std::streamsize precision=os.precision(std::numeric_limits<double>::max_digits10);
+	for(size_t k=0;k<sv.size();++k)
+		os << (k ? " " : "") << sv[k].first << ":" << sv[k].second;
+	os.precision(precision);
+}
+
+// text ensembles in memory are read in parallel if at least this many bytes remain
+const size_t PARALLEL_READ_BYTES = 1<<20;
+
+// threads used to read text ensembles, see SVMEnsemble::set_read_threads()
+unsigned readThreads = 0;
+
+/**
+ * Returns the start of the line after the one at pos.
+ */
+const char* skip_line(const char *pos, const char *end){
+	const char *newline=static_cast<const char*>(memchr(pos,'\n',end-pos));
+	return newline ? newline+1 : end;
+}
+
+/**
+ * Returns whether the line at pos consists of text.
+ */
+bool is_line(const char *pos, const char *end, const char *text){
+	size_t length=strlen(text);
+	return static_cast<size_t>(end-pos)>=length && memcmp(pos,text,length)==0
+			&& (pos+length==end || pos[length]=='\n');
+}
+
+/**
+ * Line boundaries of the SVs and models of a text ensemble, used to parse them independently.
+ */
+struct TextSections{
+	std::vector<const char*> svs;		// start of every SV line, followed by the start of the models
+	std::vector<const char*> models;	// start of every model
+
+	/**
+	 * Locates <numsv> SVs and <nummodels> models in the text from begin, returns false if it is malformed.
+	 */
+	bool scan(const char *begin, const char *end, unsigned numsv, unsigned nummodels){
+		const char *pos=begin;
+		svs.reserve(numsv+1);
+		for(unsigned i=0;i<numsv;++i){
+			if(pos==end) return false;
+			svs.push_back(pos);
+			pos=skip_line(pos,end);
+		}
+		svs.push_back(pos);
+
+		if(!is_line(pos,end,"*** MODELS ***")) return false;
+		models.reserve(nummodels);
+		for(pos=skip_line(pos,end);pos!=end && models.size()<nummodels;pos=skip_line(pos,end)){
+			if(is_line(pos,end,"SVMModel")) models.push_back(pos);
+		}
+		return models.size()==nummodels;
+	}
+};
+
 } // anonymous namespace
 
 namespace ensemble{
@@ -55,8 +282,8 @@ public:
 	typedef std::deque<std::shared_ptr<SparseVector>> SVDeque;
 	typedef SVDeque::iterator sv_iterator;
 	typedef SVDeque::const_iterator sv_const_iterator;
-	typedef std::map<const SparseVector*,int,SVSort> SVMap;
-	typedef std::map<SVMModel*,int> modelCont;
+	typedef std::unordered_map<const SparseVector*,int,SVHash,SVEqual> SVMap;
+	typedef std::vector<std::pair<SVMModel*,int>> modelCont;
 	typedef modelCont::iterator iterator;
 	typedef modelCont::const_iterator const_iterator;
 	typedef std::map< std::string, std::string > LabelMap;
@@ -68,27 +295,307 @@ protected:
 	// deque containing actual distinct SVs
 	SVDeque svJumpTable;
 
-	// we use a set to exploit fast search when adding additional SVs.
+	/**
+	 * Copies of the distinct SVs and dual coefficients used for predictions, with values of type T.
+	 *
+	 * With T=int8_t the SV values are int8 levels, value q of feature f stands for q*int8Scales[f],
+	 * and dual coefficients are doubles. Queries are scaled to match, see stored_query().
+	 */
+	template <typename T>
+	struct Storage{
+		typedef typename std::conditional<std::is_same<T,int8_t>::value,double,T>::type Coefficient;
+
+		// contiguous copy of svJumpTable, row i equals *svJumpTable[i] rounded to the encoding
+		BasicSparseMatrix<T> pool;
+
+		// squared norms of the SVs as stored in pool
+		std::vector<double> squares;
+
+		// dense segments of the distinct SVs, see svSegments
+		// mutable since prepare() may lay them out as a dense matrix
+		mutable std::vector<T> segments;
+
+		// amount of distinct SVs whose segments are rows of a dense matrix, see layout_dense()
+		mutable size_t matrixRows=0;
+
+		// dual coefficients as a models x distinct SVs matrix, row i belongs to models[i]
+		BasicSparseMatrix<Coefficient> coefficients;
+
+		// inverted index of pool: row f holds (SV index, value) for all SVs with a nonzero at feature f
+		mutable BasicSparseMatrix<T> featureIndex;
+
+		void clear(){
+			pool.clear();
+			squares.clear();
+			segments.clear();
+			matrixRows=0;
+			coefficients.clear();
+			featureIndex.clear();
+		}
+	};
+
+	// only the storage selected by int8Storage or else singlePrecision is filled,
+	// see SVMEnsemble::set_single_precision()
+	Storage<double> doubles;
+	Storage<float> floats;
+	Storage<int8_t> levels;
+	bool singlePrecision=false;
+
+	// predictions use int8 levels for int8 values and kernels based on inner products, see select_storage()
+	bool int8Storage=false;
+
+	// scale of every feature for int8 values, zero for features without nonzeros
+	std::vector<double> int8Scales;
+
+	// stored and serialized SV values are rounded to this encoding, see SVMEnsemble::quantize()
+	SVMEnsemble::ValueEncoding encoding=SVMEnsemble::DOUBLE_VALUES;
+
+	mutable bool useFeatureIndex=false;
+
+	// for linear kernels all base models collapse into weight vectors, stored feature-major:
+	// row f holds (model index, weight) for all models with a nonzero weight at feature f
+	mutable SparseMatrix linearWeights;
+	mutable bool useLinearWeights=false;
+
+	// output labels, so predictions into a PredictionContext need not copy them
+	mutable std::string positiveLabel;
+	mutable std::string negativeLabel;
+
+	// the structures above are built on first use and invalidated when models are added
+#ifdef HAVE_PTHREAD
+	mutable std::atomic<bool> prepared{false};
+	mutable std::mutex prepareMutex;
+#else
+	mutable bool prepared=false;
+#endif
+
+	// interning table of the distinct SVs, used to find existing SVs when adding models
+	// only the first numInterned elements of svJumpTable are in it, see intern()
 	SVMap supportVectors;
+	size_t numInterned=0;
 
 	// maps indices in the ensemble to svJumpTable
 	std::deque<unsigned> SVindex;
 
-	// map containing model and initial index of this model in SVindex
+	// models and the initial index of each model in SVindex, in order of addition
 	modelCont models;
 
-	// used during predictions
-	mutable std::vector<std::vector<double>> denseSVs;
+	// position of each model in models
+	std::map<const SVMModel*,unsigned> modelPositions;
+
+	// constants in the decision functions, element i belongs to models[i]
+	std::vector<double> rhos;
+
+	/**
+	 * Dense copy of the features [first,first+length) of a distinct SV, stored in Storage::segments.
+	 *
+	 * Sparse SVs have length 0 and are only stored in Storage::pool.
+	 */
+	struct Segment{
+		size_t offset;
+		unsigned first;
+		unsigned length;
+	};
+
+	// element i belongs to distinct SV i, see DENSE_SV_DENSITY
+	mutable std::vector<Segment> svSegments;
 
 	// used to change internal model labels to labels as found in data file
 	LabelMap labelmap; // fixme: remove
 
-	std::vector<double> predict_by_cache(const std::vector<double>& cache) const;
+#ifdef HAVE_PTHREAD
+	// splits single predictions over multiple threads, see SVMEnsemble::set_num_threads()
+	std::unique_ptr<WorkerTeam> team;
+#endif
+
+	/**
+	 * Calls f(begin,end) for consecutive ranges that cover [0,n).
+	 *
+	 * Ranges are processed by the worker team if parallel is true and a team exists.
+	 */
+	template <typename F>
+	void for_ranges(size_t n, bool parallel, const F& f) const{
+#ifdef HAVE_PTHREAD
+		if(parallel && team){
+			size_t parts=RANGES_PER_THREAD*team->num_threads();
+			auto range=[&](size_t p){ f(p*n/parts,(p+1)*n/parts); };
+			team->run(range,parts);
+			return;
+		}
+#endif
+		f(0,n);
+	}
+
+	template <typename T>
+	std::vector<double> predict_by_cache(const Storage<T>& s, const std::vector<double>& cache) const;
+
+	/**
+	 * Computes all base model decision values based on the kernel cache, writes them into <decision_vals>.
+	 */
+	template <typename T>
+	void predict_by_cache(const Storage<T>& s, const std::vector<double>& cache, std::vector<double>& decision_vals) const;
+
+	/**
+	 * Rebuilds the kernel evaluation structures from the SVs and models.
+	 */
+	void rebuild();
+
+	/**
+	 * Returns the scale of every feature for int8 values: its largest magnitude over the SVs divided by 127.
+	 */
+	std::vector<double> feature_scales() const;
+
+	/**
+	 * Sets int8Storage and int8Scales from the encoding and the kernel, without rebuilding.
+	 *
+	 * scales are those to round the SV values with, they are derived from the SVs if empty.
+	 */
+	void select_storage(std::vector<double> scales=std::vector<double>());
+
+	/**
+	 * Returns the values of sv rounded to the encoding, as they are stored and serialized.
+	 */
+	SparseVector::SparseSV quantized(const SparseVector& sv) const;
+
+	/**
+	 * Appends a distinct SV to the kernel evaluation structures.
+	 */
+	void appendSV(const SparseVector& sv);
+	template <typename T>
+	void appendSV(Storage<T>& s, const SparseVector& sv, Segment& segment);
+	void appendSV(Storage<int8_t>& s, const SparseVector& sv, Segment& segment);
+
+	/**
+	 * Copies the values of a stored SV into its segment, if it has one.
+	 */
+	template <typename T>
+	void appendSegment(Storage<T>& s, const BasicSparseRow<T>& stored, Segment& segment);
+
+	/**
+	 * Reserves the kernel evaluation structures for the given amount of distinct SVs and their nonzeros.
+	 */
+	void reserveSV(size_t numsv, size_t nnz);
+
+	/**
+	 * Appends the dual coefficients of a model to the kernel evaluation structures.
+	 */
+	void appendCoefficients(const SparseVector::SparseSV& coefs);
+
+	/**
+	 * Evaluates a kernel that is not based on inner products between distinct SV <svidx> and x.
+	 */
+	template <typename T>
+	double row_k_function(const Storage<T>& s, size_t svidx, const SparseVectorView& x) const;
+	double row_k_function(const Storage<int8_t>& s, size_t svidx, const SparseVectorView& x) const;
+
+	/**
+	 * Scratch space for the queries of int8 storage, see stored_query().
+	 */
+	struct QueryBuffer{
+		std::vector<unsigned> indices;
+		std::vector<double> values;
+	};
+
+	/**
+	 * Returns x in the coordinates of the SV values in s.
+	 *
+	 * Int8 storage holds levels, so for kernels based on inner products x is multiplied by the
+	 * feature scales into buffer, once per query. Inner products with the levels then equal those
+	 * with the SV values, while squared norms must still be taken from x. Other storages return x.
+	 */
+	template <typename T>
+	SparseVectorView stored_query(const Storage<T>& s, const SparseVectorView& x, QueryBuffer& buffer) const;
+	SparseVectorView stored_query(const Storage<int8_t>& s, const SparseVectorView& x, QueryBuffer& buffer) const;
+	template <typename T>
+	const std::vector<double>& stored_query(const Storage<T>& s, const std::vector<double>& x, QueryBuffer& buffer) const;
+	const std::vector<double>& stored_query(const Storage<int8_t>& s, const std::vector<double>& x, QueryBuffer& buffer) const;
+
+	/**
+	 * Adds the distinct SVs that are not interned yet to supportVectors.
+	 *
+	 * Readers append SVs without interning them, since models read along with them refer to SVs by index.
+	 */
+	void intern();
+
+	/**
+	 * Discards the prediction structures that depend on SVs or models.
+	 */
+	void invalidate();
+
+	/**
+	 * Builds the inverted feature index or linear weights, depending on the kernel.
+	 */
+	template <typename T>
+	void prepare(const Storage<T>& s) const;
+
+	/**
+	 * Lays out the segments as a row-major matrix if the distinct SVs are dense, see DENSE_MATRIX_DENSITY.
+	 *
+	 * All segments then cover the features [1,n] with n the largest feature index, and row i starts
+	 * at an address aligned to DENSE_ALIGNMENT bytes, i*stride elements after row 0. Dense inner
+	 * products thus run over rows of the same length with a fixed stride.
+	 */
+	template <typename T>
+	void layout_dense(const Storage<T>& s) const;
+
+	/**
+	 * Returns the inner product between distinct SV <svidx> and x.
+	 *
+	 * Dispatches on the storage of the SV and the type of x. Only a dense SV with a dense x
+	 * runs the vectorized InnerProduct(), over a row of the dense matrix if layout_dense()
+	 * built one and over the SV's segment otherwise. A dense SV with a sparse x gathers
+	 * the segment at the nonzeros of x, a sparse SV with a dense x gathers x at the nonzeros
+	 * of the SV and two sparse operands merge their indices, all in scalar loops.
+	 */
+	template <typename T>
+	double inner_product(const Storage<T>& s, size_t svidx, const SparseVectorView& x) const;
+	template <typename T>
+	double inner_product(const Storage<T>& s, size_t svidx, const std::vector<double>& x) const;
+
+	/**
+	 * Returns the inverted feature index, or nullptr if it should not be used.
+	 */
+	template <typename T>
+	const BasicSparseMatrix<T>* getFeatureIndex(const Storage<T>& s) const;
+
+	/**
+	 * Computes all base model decision values via linearWeights, writes them into <decision_vals>.
+	 */
+	void linear_decision_value(const SparseVectorView& x, std::vector<double>& decision_vals) const;
+	void linear_decision_value(const std::vector<double>& x, std::vector<double>& decision_vals) const;
+
+	/**
+	 * Fills cache with the kernel evaluations between all distinct SVs and x.
+	 */
+	template <typename T>
+	void fill_cache(const Storage<T>& s, const SparseVectorView& x, std::vector<double>& cache) const;
+
+	/**
+	 * Fills cache[begin:end]. If innerproducts is true, it already contains the inner products.
+	 */
+	template <typename T>
+	void fill_cache(const Storage<T>& s, const SparseVectorView& x, double xsquare, bool innerproducts,
+			std::vector<double>& cache, size_t begin, size_t end) const;
+
+	/**
+	 * Implementations of the public prediction functions for the given storage.
+	 */
+	template <typename T>
+	std::vector<double> decision_value(const Storage<T>& s, const SparseVectorView &x) const;
+	template <typename T>
+	void decision_value(const Storage<T>& s, const SparseVectorView &x, std::vector<double>& cache, std::vector<double>& decision_vals) const;
+	template <typename T>
+	std::vector<double> decision_value(const Storage<T>& s, const std::vector<double> &x) const;
+	template <typename T>
+	std::vector<std::vector<double>> decision_values(const Storage<T>& s, const std::vector<const SparseVector*>& batch) const;
+	template <typename T>
+	std::vector<double> lazy_decision_value(const Storage<T>& s, const SparseVectorView &x, const std::function<bool(size_t,double)>& stop) const;
 
 	/**
 	 * Returns the Prediction based on the decision values, if majority voting is used.
 	 */
 	Prediction decval2prediction(std::vector<double>&& decision_vals) const;
+	void decval2prediction(const std::vector<double>& decision_vals, Prediction& pred) const;
 
 public:
 	/**
@@ -107,6 +614,7 @@ public:
 	 * Subsequent scores are decision values per base model.
 	 */
 	virtual Prediction predict(const SparseVector &i) const override;
+	virtual Prediction predict(const SparseVectorView &i) const override;
 
 	/**
 	 * Dense prediction.
@@ -117,10 +625,36 @@ public:
 	 * Returns the base model decision values for prediction of the test instance.
 	 */
 	virtual std::vector<double> decision_value(const SparseVector &i) const override final;
+	virtual std::vector<double> decision_value(const SparseVectorView &i) const override final;
 	virtual std::vector<double> decision_value(const std::vector<double> &i) const override final;
 
+	virtual const Prediction& predict(PredictionContext& ctx, const SparseVectorView &x) const override;
+	virtual const std::vector<double>& decision_value(PredictionContext& ctx, const SparseVectorView &x) const override;
+	virtual void reserve(PredictionContext& ctx) const override;
+
+	/**
+	 * Returns the base model decision values for a block of test instances.
+	 */
+	virtual std::vector<std::vector<double>> decision_values(const std::vector<const SparseVector*>& batch) const override final;
+
+	/**
+	 * Evaluates the base models one by one until stop returns true, with lazily computed kernel evaluations.
+	 */
+	std::vector<double> lazy_decision_value(const SparseVectorView &i, const std::function<bool(size_t,double)>& stop) const;
+
+	/**
+	 * Folds the base models into a single SVMModel, see SVMEnsemble::combine().
+	 */
+	std::unique_ptr<SVMModel> combine(const std::vector<double>& coeffs, double offset) const;
+
+	/**
+	 * Returns a copy in which near-duplicate distinct SVs are merged, see SVMEnsemble::merge().
+	 */
+	unique_ptr<SVMEnsembleImpl> merged(double tolerance, const SVMEnsemble* ens) const;
+
 	// Adds SVM model *m to the SVMEnsembleImpl.
-	virtual void add(std::unique_ptr<SVMModel> m, const SVMEnsemble* ens);
+	// If svidx is given, SV j of the model is distinct SV svidx[j] and it is not looked up.
+	virtual void add(std::unique_ptr<SVMModel> m, const SVMEnsemble* ens, const unsigned *svidx=nullptr);
 
 	unsigned getSVindex(unsigned ensembleidx) const;
 	unsigned getSVindex(unsigned localidx, const SVMModel * const mod) const;
@@ -149,10 +683,46 @@ public:
 
 	const Kernel *getKernel() const;
 
+	void set_num_threads(unsigned numthreads);
+	unsigned num_threads() const;
+
+	/**
+	 * Switches the storage used for predictions between double and single precision.
+	 */
+	void set_single_precision(bool enable);
+	bool single_precision() const;
+
+	void quantize(SVMEnsemble::ValueEncoding encoding);
+	SVMEnsemble::ValueEncoding value_encoding() const;
+
 	virtual void printSV(std::ostream &os, int SVidx) const;
 
 	virtual void serialize(std::ostream& os) const override;
 	static unique_ptr<SVMEnsemble> read(std::istream &iss);
+
+	/**
+	 * Binary format: the kernel, label map and classes as text, SVs in CSR format and per model
+	 * arrays of distinct SV indices, weights and constants, each aligned so it can be read without copying.
+	 *
+	 * Reading decodes the sections directly from the mapped file without parsing numbers, but the
+	 * SVs, weights and constants are still copied into the ensemble's own storage.
+	 *
+	 * read_binary() continues after the line that marks the format, which is passed as header.
+	 * If selection is given, only those base models and the SVs they refer to are read.
+	 */
+	void serialize_binary(std::ostream& os) const;
+	static unique_ptr<SVMEnsemble> read_binary(std::istream &iss, std::istream &header,
+			const std::vector<unsigned> *selection=nullptr);
+
+	/**
+	 * Loads a selection of base models, see SVMEnsemble::load().
+	 */
+	static unique_ptr<SVMEnsemble> load(const std::string &fname, const std::vector<unsigned>& selection);
+
+	/**
+	 * Returns a copy with the selected base models.
+	 */
+	unique_ptr<SVMEnsembleImpl> selected(const std::vector<unsigned>& selection, const SVMEnsemble* ens) const;
 //	static unique_ptr<ensemble::SVMEnsemble> load(const string &fname);
 
 	double density() const;
@@ -181,6 +751,90 @@ SVMEnsembleImpl::sv_const_iterator SVMEnsembleImpl::sv_end() const{ return svJum
 
 const Kernel *SVMEnsembleImpl::getKernel() const{ return kernel.get(); }
 
+void SVMEnsembleImpl::set_num_threads(unsigned numthreads){
+#ifdef HAVE_PTHREAD
+	team.reset(numthreads>1 ? new WorkerTeam(numthreads) : nullptr);
+#endif
+}
+unsigned SVMEnsembleImpl::num_threads() const{
+#ifdef HAVE_PTHREAD
+	if(team) return team->num_threads();
+#endif
+	return 1;
+}
+
+void SVMEnsembleImpl::set_single_precision(bool enable){
+	if(enable==singlePrecision) return;
+	singlePrecision=enable;
+	rebuild();
+}
+bool SVMEnsembleImpl::single_precision() const{
+	return singlePrecision;
+}
+
+void SVMEnsembleImpl::quantize(SVMEnsemble::ValueEncoding encoding){
+	// the SVs keep their values, only the storage for predictions and serialization are rounded
+	this->encoding=encoding;
+	select_storage();
+	rebuild();
+}
+SVMEnsemble::ValueEncoding SVMEnsembleImpl::value_encoding() const{
+	return encoding;
+}
+
+std::vector<double> SVMEnsembleImpl::feature_scales() const{
+	std::vector<double> scales;
+	for(sv_const_iterator I=sv_begin(),E=sv_end();I!=E;++I){
+		for(SparseVector::const_iterator Isv=(*I)->begin(),Esv=(*I)->end();Isv!=Esv;++Isv){
+			if(Isv->first>=scales.size()) scales.resize(Isv->first+1,0.0);
+			scales[Isv->first]=std::max(scales[Isv->first],std::abs(Isv->second));
+		}
+	}
+	for(double& scale: scales){
+		// the largest rounded value must yield the same scale again, so that rounding is idempotent
+		scale/=INT8_MAX_LEVEL;
+		while(scale>0.0 && scale*INT8_MAX_LEVEL/INT8_MAX_LEVEL!=scale)
+			scale=std::nextafter(scale,HUGE_VAL);
+	}
+	return scales;
+}
+
+void SVMEnsembleImpl::select_storage(std::vector<double> scales){
+	int8Storage = encoding==SVMEnsemble::INT8_VALUES && kernel->isInnerProductBased();
+	int8Scales.clear();
+	if(encoding==SVMEnsemble::INT8_VALUES)
+		int8Scales = scales.empty() ? feature_scales() : std::move(scales);
+}
+
+SparseVector::SparseSV SVMEnsembleImpl::quantized(const SparseVector& sv) const{
+	SparseVector::SparseSV rounded;
+	rounded.reserve(sv.numNonzero());
+	for(SparseVector::const_iterator I=sv.begin(),E=sv.end();I!=E;++I){
+		double scale = I->first<int8Scales.size() ? int8Scales[I->first] : 0.0;
+		rounded.push_back(std::make_pair(I->first,quantize_value(I->second,encoding,scale)));
+	}
+	return rounded;
+}
+
+void SVMEnsembleImpl::rebuild(){
+	// rebuild the selected storage from the SVs and models, which are always in double precision and unrounded
+	doubles.clear();
+	floats.clear();
+	levels.clear();
+	svSegments.clear();
+	for(sv_const_iterator I=sv_begin(),E=sv_end();I!=E;++I)
+		appendSV(**I);
+	for(const_iterator I=begin(),E=end();I!=E;++I){
+		SparseVector::SparseSV coefs;
+		coefs.reserve(I->first->size());
+		SVMModel::const_weight_iter Iw=I->first->weight_begin();
+		for(unsigned j=0;j<I->first->size();++j)
+			coefs.push_back(std::make_pair(SVindex[I->second+j],Iw[j]));
+		appendCoefficients(coefs);
+	}
+	invalidate();
+}
+
 Ensemble::Ensemble(const Ensemble &e):BinaryModel(e){}
 Ensemble::Ensemble():BinaryModel(){}
 
@@ -231,11 +885,12 @@ const SparseVector* SVMEnsembleImpl::getSV(unsigned ensidx) const{
 	return svJumpTable[ensidx].get();
 }
 
-void SVMEnsembleImpl::add(std::unique_ptr<SVMModel> m, const SVMEnsemble* ens){
+void SVMEnsembleImpl::add(std::unique_ptr<SVMModel> m, const SVMEnsemble* ens, const unsigned *svidx){
 	int startidx = SVindex.size();
 	SVMModel *newmodel = m.get();
 
-	models.insert(std::make_pair(newmodel,startidx));
+	modelPositions.insert(std::make_pair(newmodel,models.size()));
+	models.push_back(std::make_pair(newmodel,startidx));
 
 	if(labelmap.empty()){
 		std::string pos=m->positive_label();
@@ -262,9 +917,22 @@ void SVMEnsembleImpl::add(std::unique_ptr<SVMModel> m, const SVMEnsemble* ens){
 		newmodel->kernel=kernel.get();
 	}
 
-	// extract SVs
+	// extract SVs and dual coefficients
+	SparseVector::SparseSV coefs;
+	coefs.reserve(newmodel->size());
+	if(!svidx){
+		intern();
+		supportVectors.reserve(supportVectors.size()+newmodel->size());
+	}
+	SVMModel::const_weight_iter Iw=newmodel->weight_begin();
 	int SVnum=0;
 	for(SVMModel::iterator Im=newmodel->begin(),Em=newmodel->end();Im!=Em;++Im,++SVnum){
+		if(svidx){
+			SVindex.push_back(svidx[SVnum]);
+			coefs.push_back(std::make_pair(svidx[SVnum],*Iw++));
+			continue;
+		}
+
 		int jtIdx=svJumpTable.size();
 
 		std::pair<SVMap::iterator,bool > insertion=supportVectors.insert(std::make_pair(Im->get(),jtIdx));
@@ -275,14 +943,366 @@ void SVMEnsembleImpl::add(std::unique_ptr<SVMModel> m, const SVMEnsemble* ens){
 		if(svIsNew){
 			// supportvector did NOT exist yet, add to jt
 			svJumpTable.push_back(*Im);
+			numInterned=svJumpTable.size();
+			appendSV(**Im);
 		}
 
 		newmodel->redirectSV(Im,svJumpTable.at(jtIdx));
 
 		// update index
 		SVindex.push_back(jtIdx);
+		coefs.push_back(std::make_pair(jtIdx,*Iw++));
 	}
+	appendCoefficients(coefs);
+	rhos.push_back(newmodel->getConstant(0));
+	invalidate();
 	m.release();
+
+	if(encoding==SVMEnsemble::INT8_VALUES && !svidx){
+		// new SVs may extend the range of features, which changes the levels of all SVs
+		std::vector<double> scales=feature_scales();
+		if(scales!=int8Scales){
+			select_storage(std::move(scales));
+			rebuild();
+		}
+	}
+}
+
+void SVMEnsembleImpl::reserveSV(size_t numsv, size_t nnz){
+	svSegments.reserve(svSegments.size()+numsv);
+	if(int8Storage){
+		levels.pool.reserve(levels.pool.rows()+numsv,levels.pool.numNonzero()+nnz);
+		levels.squares.reserve(levels.squares.size()+numsv);
+	}else if(singlePrecision){
+		floats.pool.reserve(floats.pool.rows()+numsv,floats.pool.numNonzero()+nnz);
+		floats.squares.reserve(floats.squares.size()+numsv);
+	}else{
+		doubles.pool.reserve(doubles.pool.rows()+numsv,doubles.pool.numNonzero()+nnz);
+		doubles.squares.reserve(doubles.squares.size()+numsv);
+	}
+}
+
+void SVMEnsembleImpl::intern(){
+	for(;numInterned<svJumpTable.size();++numInterned)
+		supportVectors.insert(std::make_pair(svJumpTable[numInterned].get(),numInterned));
+}
+
+void SVMEnsembleImpl::appendSV(const SparseVector& sv){
+	// the density is relative to the span of the SV's nonzeros, which is what a segment stores
+	Segment segment{0,0,0};
+	unsigned first = sv.numNonzero() ? sv.begin()->first : 0;
+	unsigned span = sv.numNonzero() ? sv.rbegin()->first-first+1 : 0;
+	if(span && sv.numNonzero()>=DENSE_SV_DENSITY*span){
+		segment.first=first;
+		segment.length=span;
+	}
+	svSegments.push_back(segment);
+
+	if(int8Storage) appendSV(levels,sv,svSegments.back());
+	else if(singlePrecision) appendSV(floats,sv,svSegments.back());
+	else appendSV(doubles,sv,svSegments.back());
+	invalidate();
+}
+
+template <typename T>
+void SVMEnsembleImpl::appendSV(Storage<T>& s, const SparseVector& sv, Segment& segment){
+	size_t row = encoding==SVMEnsemble::DOUBLE_VALUES ? s.pool.append(sv) : s.pool.append(quantized(sv));
+
+	// squared norms are based on the stored values, so that kernels are consistent with them
+	BasicSparseRow<T> stored=s.pool.row(row);
+	s.squares.push_back(squaredNorm(stored));
+	appendSegment(s,stored,segment);
+}
+
+void SVMEnsembleImpl::appendSV(Storage<int8_t>& s, const SparseVector& sv, Segment& segment){
+	// values are rounded to levels like quantized() does, squared norms are those of the rounded values
+	SparseVector::SparseSV rounded;
+	rounded.reserve(sv.numNonzero());
+	double square=0.0;
+	for(SparseVector::const_iterator I=sv.begin(),E=sv.end();I!=E;++I){
+		double scale = I->first<int8Scales.size() ? int8Scales[I->first] : 0.0;
+		int8_t level=to_int8(I->second,scale);
+		rounded.push_back(std::make_pair(I->first,static_cast<double>(level)));
+		square+=(level*scale)*(level*scale);
+	}
+	size_t row=s.pool.append(rounded);
+	s.squares.push_back(square);
+	appendSegment(s,s.pool.row(row),segment);
+}
+
+template <typename T>
+void SVMEnsembleImpl::appendSegment(Storage<T>& s, const BasicSparseRow<T>& stored, Segment& segment){
+	if(segment.length){
+		segment.offset=(s.segments.size()+SEGMENT_ALIGNMENT-1)/SEGMENT_ALIGNMENT*SEGMENT_ALIGNMENT;
+		s.segments.resize(segment.offset+segment.length,0);
+		T *values=s.segments.data()+segment.offset;
+		for(size_t k=0;k<stored.nnz;++k)
+			values[stored.indices[k]-segment.first]=stored.values[k];
+	}
+}
+
+void SVMEnsembleImpl::appendCoefficients(const SparseVector::SparseSV& coefs){
+	if(int8Storage) levels.coefficients.append(coefs);
+	else if(singlePrecision) floats.coefficients.append(coefs);
+	else doubles.coefficients.append(coefs);
+}
+
+template <typename T>
+double SVMEnsembleImpl::inner_product(const Storage<T>& s, size_t svidx, const SparseVectorView& x) const{
+	const Segment& segment=svSegments[svidx];
+	if(!segment.length)
+		return InnerProduct(s.pool.row(svidx),x);
+
+	// gather the segment's values at the nonzeros of x
+	const T *values=s.segments.data()+segment.offset;
+	unsigned last=segment.first+segment.length;
+	double result=0.0;
+	for(size_t k=x.lower_bound(segment.first),n=x.numNonzero();k<n && x.index(k)<last;++k)
+		result+=values[x.index(k)-segment.first]*x.value(k);
+	return result;
+}
+template <typename T>
+double SVMEnsembleImpl::inner_product(const Storage<T>& s, size_t svidx, const std::vector<double>& x) const{
+	const Segment& segment=svSegments[svidx];
+	if(segment.length){
+		if(x.size()<segment.first) return 0.0;
+		size_t n=std::min<size_t>(segment.length,x.size()-segment.first+1);
+		return InnerProduct(s.segments.data()+segment.offset,x.data()+segment.first-1,n);
+	}
+
+	// gather the values of x at the SV's nonzeros
+	BasicSparseRow<T> sv=s.pool.row(svidx);
+	double result=0.0;
+	for(size_t k=0;k<sv.nnz && sv.indices[k]<=x.size();++k)
+		result+=sv.values[k]*x[sv.indices[k]-1];
+	return result;
+}
+
+void SVMEnsembleImpl::invalidate(){
+	// adding SVs or models may not happen concurrently with predictions
+	prepared=false;
+	doubles.featureIndex.clear();
+	floats.featureIndex.clear();
+	levels.featureIndex.clear();
+	linearWeights.clear();
+}
+
+template <typename T>
+void SVMEnsembleImpl::prepare(const Storage<T>& s) const{
+	if(prepared) return;
+#ifdef HAVE_PTHREAD
+	std::lock_guard<std::mutex> lock(prepareMutex);
+	if(prepared) return;
+#endif
+
+	useLinearWeights = kernel->getType()==KERNEL_TYPES::LINEAR;
+	useFeatureIndex = !useLinearWeights && kernel->isInnerProductBased() && density() < FEATURE_INDEX_DENSITY;
+	if(useFeatureIndex) s.featureIndex=s.pool.transpose();
+	if(kernel->isInnerProductBased() && !useLinearWeights) layout_dense(s);
+	if(useLinearWeights){
+		// weights of model i: sum_k coefficients(i,k) * pool(k), accumulated densely per model
+		size_t numfeatures=0;
+		for(size_t k=0,n=s.pool.rows();k<n;++k){
+			BasicSparseRow<T> sv=s.pool.row(k);
+			if(sv.nnz) numfeatures=std::max<size_t>(numfeatures,sv.indices[sv.nnz-1]+1);
+		}
+
+		SparseMatrix weights;
+		std::vector<double> dense(numfeatures,0.0);
+		std::vector<unsigned> touched;
+		for(size_t i=0,n=s.coefficients.rows();i<n;++i){
+			auto row=s.coefficients.row(i);
+			for(size_t k=0;k<row.nnz;++k){
+				BasicSparseRow<T> sv=s.pool.row(row.indices[k]);
+				for(size_t j=0;j<sv.nnz;++j){
+					if(dense[sv.indices[j]]==0.0) touched.push_back(sv.indices[j]);
+					dense[sv.indices[j]]+=static_cast<double>(row.values[k])*sv.values[j];
+				}
+			}
+			std::sort(touched.begin(),touched.end());
+			touched.erase(std::unique(touched.begin(),touched.end()),touched.end());
+
+			SparseVector::SparseSV w;
+			w.reserve(touched.size());
+			for(unsigned f: touched){
+				if(dense[f]!=0.0) w.push_back(std::make_pair(f,dense[f]));
+				dense[f]=0.0;
+			}
+			weights.append(w);
+			touched.clear();
+		}
+		linearWeights=weights.transpose();
+	}
+	if(!models.empty()){
+		positiveLabel=positive_label();
+		negativeLabel=negative_label();
+	}
+	prepared=true;
+}
+
+template <typename T>
+void SVMEnsembleImpl::layout_dense(const Storage<T>& s) const{
+	size_t numdistinctSV=s.pool.rows();
+	if(!numdistinctSV || s.matrixRows==numdistinctSV) return;
+
+	size_t numfeatures=0, filled=0;
+	for(size_t k=0;k<numdistinctSV;++k){
+		const Segment& segment=svSegments[k];
+		if(!segment.length || !segment.first) return;
+		numfeatures=std::max<size_t>(numfeatures,segment.first+segment.length-1);
+		filled+=segment.length;
+	}
+	if(filled<DENSE_MATRIX_DENSITY*numfeatures*numdistinctSV) return;
+
+	// rows are zero padded to a multiple of DENSE_ALIGNMENT bytes, one spare alignment
+	// unit allows shifting the rows to an aligned address
+	const size_t unit=DENSE_ALIGNMENT/sizeof(T);
+	size_t stride=(numfeatures+unit-1)/unit*unit;
+	std::vector<T> matrix(stride*numdistinctSV+unit,0);
+	size_t misalignment=reinterpret_cast<uintptr_t>(matrix.data())%DENSE_ALIGNMENT;
+	size_t start = misalignment ? (DENSE_ALIGNMENT-misalignment)/sizeof(T) : 0;
+
+	for(size_t k=0;k<numdistinctSV;++k){
+		Segment& segment=svSegments[k];
+		const T *values=s.segments.data()+segment.offset;
+		size_t offset=start+k*stride;
+		std::copy(values,values+segment.length,matrix.begin()+offset+segment.first-1);
+		segment=Segment{offset,1,static_cast<unsigned>(numfeatures)};
+	}
+	s.segments.swap(matrix);
+	s.matrixRows=numdistinctSV;
+}
+
+template <typename T>
+const BasicSparseMatrix<T>* SVMEnsembleImpl::getFeatureIndex(const Storage<T>& s) const{
+	prepare(s);
+	return useFeatureIndex ? &s.featureIndex : nullptr;
+}
+
+void SVMEnsembleImpl::linear_decision_value(const SparseVectorView& x, std::vector<double>& decision_vals) const{
+	assert(decision_vals.size()==size() && "Invalid output vector supplied!");
+
+	// scatter every nonzero of x over the models with a weight at its feature
+	std::fill(decision_vals.begin(),decision_vals.end(),0.0);
+	for(size_t j=0,n=x.numNonzero();j<n;++j){
+		if(x.index(j) >= linearWeights.rows())
+			break;
+		SparseRow weights=linearWeights.row(x.index(j));
+		double value=x.value(j);
+		for(size_t k=0;k<weights.nnz;++k)
+			decision_vals[weights.indices[k]]+=weights.values[k]*value;
+	}
+	for(size_t i=0,n=decision_vals.size();i<n;++i)
+		decision_vals[i]-=rhos[i];
+}
+
+void SVMEnsembleImpl::linear_decision_value(const std::vector<double>& x, std::vector<double>& decision_vals) const{
+	assert(decision_vals.size()==size() && "Invalid output vector supplied!");
+
+	std::fill(decision_vals.begin(),decision_vals.end(),0.0);
+	for(size_t f=1,n=std::min(x.size()+1,linearWeights.rows());f<n;++f){
+		double value=x[f-1];
+		if(value==0.0)
+			continue;
+		SparseRow weights=linearWeights.row(f);
+		for(size_t k=0;k<weights.nnz;++k)
+			decision_vals[weights.indices[k]]+=weights.values[k]*value;
+	}
+	for(size_t i=0,n=decision_vals.size();i<n;++i)
+		decision_vals[i]-=rhos[i];
+}
+
+template <typename T>
+void SVMEnsembleImpl::fill_cache(const Storage<T>& s, const SparseVectorView& x, std::vector<double>& cache) const{
+	// reused by the predictions of this thread, so that they do not allocate
+	static thread_local QueryBuffer buffer;
+	SparseVectorView query=stored_query(s,x,buffer);
+
+	size_t numdistinctSV=s.pool.rows();
+	const BasicSparseMatrix<T>* index = kernel->isInnerProductBased() ? getFeatureIndex(s) : nullptr;
+	if(index){
+		// accumulate inner products over the SVs that share features with x
+		std::fill(cache.begin(),cache.end(),0.0);
+		for(size_t j=0,n=query.numNonzero();j<n;++j){
+			if(query.index(j) >= index->rows())
+				break;
+			BasicSparseRow<T> svs=index->row(query.index(j));
+			double value=query.value(j);
+			for(size_t k=0;k<svs.nnz;++k)
+				cache[svs.indices[k]]+=svs.values[k]*value;
+		}
+	}
+
+	// the remaining work is independent per SV, so it is split by SV ranges
+	double xsquare=squaredNorm(x);
+	for_ranges(numdistinctSV,numdistinctSV>=PARALLEL_THRESHOLD,[&](size_t begin, size_t end){
+		fill_cache(s,query,xsquare,index!=nullptr,cache,begin,end);
+	});
+}
+
+template <typename T>
+void SVMEnsembleImpl::fill_cache(const Storage<T>& s, const SparseVectorView& x, double xsquare, bool innerproducts,
+		std::vector<double>& cache, size_t begin, size_t end) const{
+	if(!kernel->isInnerProductBased()){
+		for(size_t i=begin;i<end;++i)
+			cache[i]=row_k_function(s,i,x);
+		return;
+	}
+
+	// first all inner products, then the kernel's nonlinearity in one batch
+	if(!innerproducts){
+		for(size_t i=begin;i<end;++i)
+			cache[i]=inner_product(s,i,x);
+	}
+	kernel->k_function(cache.data()+begin,s.squares.data()+begin,xsquare,end-begin);
+}
+
+template <typename T>
+double SVMEnsembleImpl::row_k_function(const Storage<T>& s, size_t svidx, const SparseVectorView& x) const{
+	return kernel->k_function(s.pool.row(svidx),x);
+}
+double SVMEnsembleImpl::row_k_function(const Storage<int8_t>& s, size_t svidx, const SparseVectorView& x) const{
+	// kernels get the values the levels stand for
+	SparseRow8 row=s.pool.row(svidx);
+	SparseVector::SparseSV values;
+	values.reserve(row.nnz);
+	for(size_t k=0;k<row.nnz;++k)
+		values.push_back(std::make_pair(row.indices[k],row.values[k]*int8Scales[row.indices[k]]));
+	SparseVector sv(std::move(values));
+	return kernel->k_function(SparseVectorView(sv),x);
+}
+
+template <typename T>
+SparseVectorView SVMEnsembleImpl::stored_query(const Storage<T>& s, const SparseVectorView& x, QueryBuffer& buffer) const{
+	return x;
+}
+SparseVectorView SVMEnsembleImpl::stored_query(const Storage<int8_t>& s, const SparseVectorView& x, QueryBuffer& buffer) const{
+	if(!kernel->isInnerProductBased()) return x;
+
+	// features without scale are zero in all SVs, so they do not contribute to inner products
+	buffer.indices.clear();
+	buffer.values.clear();
+	for(size_t k=0,n=x.numNonzero();k<n && x.index(k)<int8Scales.size();++k){
+		double scale=int8Scales[x.index(k)];
+		if(scale==0.0) continue;
+		buffer.indices.push_back(x.index(k));
+		buffer.values.push_back(x.value(k)*scale);
+	}
+	return SparseVectorView(buffer.indices.data(),buffer.values.data(),buffer.values.size());
+}
+template <typename T>
+const std::vector<double>& SVMEnsembleImpl::stored_query(const Storage<T>& s, const std::vector<double>& x, QueryBuffer& buffer) const{
+	return x;
+}
+const std::vector<double>& SVMEnsembleImpl::stored_query(const Storage<int8_t>& s, const std::vector<double>& x, QueryBuffer& buffer) const{
+	if(!kernel->isInnerProductBased()) return x;
+
+	// element f-1 holds feature f
+	size_t n = int8Scales.empty() ? 0 : std::min(x.size(),int8Scales.size()-1);
+	buffer.values.resize(n);
+	for(size_t f=1;f<=n;++f)
+		buffer.values[f-1]=x[f-1]*int8Scales[f];
+	return buffer.values;
 }
 
 std::string SVMEnsembleImpl::translate(const std::string &label) const{
@@ -308,7 +1328,8 @@ double SVMEnsembleImpl::density() const{
 			maxdim=maxdim > thissize ? maxdim : thissize;
 		}
 	}
-	return static_cast<double>(totallength)/maxdim;
+	if(maxdim==0) return 0.0;
+	return static_cast<double>(totallength)/(maxdim*numDistinctSV());
 }
 
 // fixme not exactly efficient
@@ -322,50 +1343,52 @@ std::string SVMEnsembleImpl::negative_label() const{
 size_t SVMEnsembleImpl::num_outputs() const{
 	return size();
 }
-std::vector<double> SVMEnsembleImpl::predict_by_cache(const std::vector<double>& cache) const{
-
-	// initialize voting map: <label, vote count>
-	std::map<string,unsigned> votes;
-	const SVMModel *firstmodel=models.begin()->first;
-	for(unsigned i=0;i<firstmodel->getNumClasses();++i)
-		votes.insert(std::make_pair(translate(firstmodel->getLabel(i)),0));
-
-	std::vector<double> decision_vals;
-	decision_vals.reserve(size());
-
-	std::map<string,unsigned>::iterator Iv, Ev;
-	for(const_iterator I=begin(),E=end();I!=E;++I){
-		// make predictions with cached kernel evaluations
-		unsigned modelsize=I->first->size();
-		std::vector<double> kernelevals(modelsize,0);
-
-		for(unsigned idx=0;idx<modelsize;++idx){
-			kernelevals[idx]=cache.at(getSVindex(idx+I->second));
-		}
-
-		decision_vals.emplace_back(I->first->predict_by_cache(kernelevals));
-	}
-
+template <typename T>
+std::vector<double> SVMEnsembleImpl::predict_by_cache(const Storage<T>& s, const std::vector<double>& cache) const{
+	std::vector<double> decision_vals(size(),0.0);
+	predict_by_cache(s,cache,decision_vals);
 	return std::move(decision_vals);
 }
+template <typename T>
+void SVMEnsembleImpl::predict_by_cache(const Storage<T>& s, const std::vector<double>& cache, std::vector<double>& decision_vals) const{
+	assert(cache.size()==numDistinctSV() && "Invalid kernel cache vector supplied!");
+	assert(decision_vals.size()==size() && "Invalid output vector supplied!");
+
+	// sparse matrix-vector product between coefficients and the kernel cache, split by models
+	for_ranges(s.coefficients.rows(),s.coefficients.numNonzero()>=PARALLEL_THRESHOLD,[&](size_t begin, size_t end){
+		for(size_t i=begin;i<end;++i){
+			auto row=s.coefficients.row(i);
+			double sum=0.0;
+			for(size_t k=0;k<row.nnz;++k)
+				sum+=row.values[k]*cache[row.indices[k]];
+			decision_vals[i]=sum-rhos[i];
+		}
+	});
+}
 
 Prediction SVMEnsembleImpl::decval2prediction(std::vector<double>&& decision_vals) const{
-
-	Prediction pred(size()+1);
+	Prediction pred;
+	decval2prediction(decision_vals,pred);
+	return pred;
+}
+void SVMEnsembleImpl::decval2prediction(const std::vector<double>& decision_vals, Prediction& pred) const{
+	pred.resize(size()+1);
 	unsigned numpos = std::count_if(decision_vals.begin(),decision_vals.end(),
 			[](double decval){ return decval > 0; });
 	if(2*numpos > size()){
-		pred.setLabel(positive_label());
+		pred.setLabel(positiveLabel);
 		pred[0]=1.0*numpos/size();
 	}else{
 		pred[0]=1.0-1.0*numpos/size();
-		pred.setLabel(negative_label());
+		pred.setLabel(negativeLabel);
 	}
 	std::copy(decision_vals.begin(),decision_vals.end(),pred.begin()+1);
-	return std::move(pred);
 }
 
 Prediction SVMEnsembleImpl::predict(const SparseVector &x) const{
+	return predict(SparseVectorView(x));
+}
+Prediction SVMEnsembleImpl::predict(const SparseVectorView &x) const{
 	std::vector<double> decvals=decision_value(x);
 	return decval2prediction(std::move(decvals));
 }
@@ -376,45 +1399,330 @@ Prediction SVMEnsembleImpl::predict(const std::vector<double>& x) const{
 }
 
 std::vector<double> SVMEnsembleImpl::decision_value(const SparseVector &x) const{
+	return decision_value(SparseVectorView(x));
+}
+std::vector<double> SVMEnsembleImpl::decision_value(const SparseVectorView &x) const{
+	if(int8Storage) return decision_value(levels,x);
+	return singlePrecision ? decision_value(floats,x) : decision_value(doubles,x);
+}
+std::vector<double> SVMEnsembleImpl::decision_value(const std::vector<double> &x) const{
+	if(int8Storage) return decision_value(levels,x);
+	return singlePrecision ? decision_value(floats,x) : decision_value(doubles,x);
+}
+const Prediction& SVMEnsembleImpl::predict(PredictionContext& ctx, const SparseVectorView &x) const{
+	decval2prediction(decision_value(ctx,x),ctx.prediction);
+	return ctx.prediction;
+}
+const std::vector<double>& SVMEnsembleImpl::decision_value(PredictionContext& ctx, const SparseVectorView &x) const{
+	if(int8Storage) decision_value(levels,x,ctx.cache,ctx.decision_values);
+	else if(singlePrecision) decision_value(floats,x,ctx.cache,ctx.decision_values);
+	else decision_value(doubles,x,ctx.cache,ctx.decision_values);
+	return ctx.decision_values;
+}
+void SVMEnsembleImpl::reserve(PredictionContext& ctx) const{
+	ctx.cache.reserve(numDistinctSV());
+	ctx.decision_values.reserve(size());
+	ctx.prediction.resize(size()+1);
+}
+std::vector<std::vector<double>> SVMEnsembleImpl::decision_values(const std::vector<const SparseVector*>& batch) const{
+	if(int8Storage) return decision_values(levels,batch);
+	return singlePrecision ? decision_values(floats,batch) : decision_values(doubles,batch);
+}
+std::vector<double> SVMEnsembleImpl::lazy_decision_value(const SparseVectorView &x, const std::function<bool(size_t,double)>& stop) const{
+	if(int8Storage) return lazy_decision_value(levels,x,stop);
+	return singlePrecision ? lazy_decision_value(floats,x,stop) : lazy_decision_value(doubles,x,stop);
+}
+
+template <typename T>
+std::vector<double> SVMEnsembleImpl::decision_value(const Storage<T>& s, const SparseVectorView &x) const{
+	std::vector<double> cache, decision_vals;
+	decision_value(s,x,cache,decision_vals);
+	return decision_vals;
+}
+template <typename T>
+void SVMEnsembleImpl::decision_value(const Storage<T>& s, const SparseVectorView &x, std::vector<double>& cache, std::vector<double>& decision_vals) const{
 	assert(models.size()>0 && "Trying to make predictions with an empty ensemble!");
 
-	// maintain records of which kernel evaluations have already been performed
-	unsigned numdistinctSV=svJumpTable.size();
+	prepare(s);
+	decision_vals.resize(size());
+	if(useLinearWeights){
+		static thread_local QueryBuffer buffer;
+		linear_decision_value(stored_query(s,x,buffer),decision_vals);
+		return;
+	}
 
-	// fill the cache
-	std::vector<double> cache;
-	cache.reserve(numdistinctSV);
+	// one kernel evaluation per distinct SV, every entry is overwritten by fill_cache()
+	cache.resize(svJumpTable.size());
+	fill_cache(s,x,cache);
+	predict_by_cache(s,cache,decision_vals);
+}
+template <typename T>
+std::vector<double> SVMEnsembleImpl::decision_value(const Storage<T>& s, const std::vector<double> &x) const{
+	assert(models.size()>0 && "Trying to make predictions with an empty ensemble!");
 
-	unsigned i=0;
-	for(SVDeque::const_iterator I=svJumpTable.begin(),E=svJumpTable.end();I!=E;++I,++i)
-		cache.emplace_back(kernel->k_function(I->get(),&x));
+	prepare(s);
+	QueryBuffer buffer;
+	const std::vector<double>& query=stored_query(s,x,buffer);
+	if(useLinearWeights){
+		std::vector<double> decision_vals(size(),0.0);
+		linear_decision_value(query,decision_vals);
+		return decision_vals;
+	}
 
-	return predict_by_cache(cache);
+	size_t numdistinctSV=s.pool.rows();
+	std::vector<double> cache(numdistinctSV,0.0);
+
+	if(kernel->isInnerProductBased()){
+		// inner products per SV storage type, then the kernel's nonlinearity in one batch
+		double xsquare=squaredNorm(x.data(),x.size());
+		for_ranges(numdistinctSV,numdistinctSV>=PARALLEL_THRESHOLD,[&](size_t begin, size_t end){
+			for(size_t i=begin;i<end;++i)
+				cache[i]=inner_product(s,i,query);
+			kernel->k_function(cache.data()+begin,s.squares.data()+begin,xsquare,end-begin);
+		});
+	}else{
+		SparseVector sparse(x);
+		SparseVectorView view(sparse);
+		for_ranges(numdistinctSV,numdistinctSV>=PARALLEL_THRESHOLD,[&](size_t begin, size_t end){
+			for(size_t i=begin;i<end;++i)
+				cache[i]=row_k_function(s,i,view);
+		});
+	}
+
+	return predict_by_cache(s,cache);
 }
-std::vector<double> SVMEnsembleImpl::decision_value(const std::vector<double> &x) const{
+template <typename T>
+std::vector<std::vector<double>> SVMEnsembleImpl::decision_values(const Storage<T>& s, const std::vector<const SparseVector*>& batch) const{
 	assert(models.size()>0 && "Trying to make predictions with an empty ensemble!");
 
-	// maintain records of which kernel evaluations have already been performed
 	unsigned numdistinctSV=svJumpTable.size();
+	size_t numinstances=batch.size();
+
+	prepare(s);
+	if(useLinearWeights){
+		std::vector<std::vector<double>> result(numinstances,std::vector<double>(size(),0.0));
+		QueryBuffer buffer;
+		for(size_t i=0;i<numinstances;++i)
+			linear_decision_value(stored_query(s,*batch[i],buffer),result[i]);
+		return result;
+	}
 
-	// fill the cache
-	std::vector<double> cache;
-	cache.reserve(numdistinctSV);
+	std::vector<std::vector<double>> result;
+	result.reserve(numinstances);
+	if(getFeatureIndex(s)){
+		// the inverted index already restricts memory traffic to relevant SVs
+		std::vector<double> cache(numdistinctSV,0.0);
+		for(size_t i=0;i<numinstances;++i){
+			fill_cache(s,*batch[i],cache);
+			result.emplace_back(predict_by_cache(s,cache));
+		}
+		return result;
+	}
 
-	if(denseSVs.size() != numdistinctSV){
-		denseSVs.clear();
-		// initialize the dense SV cache, only happens once
-		denseSVs.reserve(numdistinctSV);
-		for(sv_const_iterator I=sv_begin(),E=sv_end();I!=E;++I)
-			denseSVs.emplace_back((*I)->dense());
+	// one kernel cache and query per instance of a tile, reused for every tile
+	std::vector<std::vector<double>> caches(std::min(numinstances,INSTANCE_TILE_SIZE),std::vector<double>(numdistinctSV,0.0));
+	std::vector<QueryBuffer> buffers(caches.size());
+	bool innerProductBased=kernel->isInnerProductBased();
+	for(size_t instart=0;instart<numinstances;instart+=INSTANCE_TILE_SIZE){
+		size_t instop=std::min(instart+INSTANCE_TILE_SIZE,numinstances);
+		std::vector<SparseVectorView> views;
+		views.reserve(instop-instart);
+		for(size_t i=instart;i<instop;++i)
+			views.push_back(stored_query(s,*batch[i],buffers[i-instart]));
+
+		// each tile of SVs is streamed once over the instances of the tile
+		for(size_t svstart=0;svstart<numdistinctSV;svstart+=SV_TILE_SIZE){
+			size_t svstop=std::min<size_t>(svstart+SV_TILE_SIZE,numdistinctSV);
+			for(size_t i=0;i<views.size();++i){
+				std::vector<double>& cache=caches[i];
+				if(innerProductBased){
+					for(size_t sv=svstart;sv<svstop;++sv)
+						cache[sv]=inner_product(s,sv,views[i]);
+				}else{
+					for(size_t sv=svstart;sv<svstop;++sv)
+						cache[sv]=row_k_function(s,sv,views[i]);
+				}
+			}
+		}
+
+		// the kernel's nonlinearity and the decision values are computed before the next tile overwrites the caches
+		for(size_t i=0;i<views.size();++i){
+			if(innerProductBased)
+				kernel->k_function(caches[i].data(),s.squares.data(),squaredNorm(*batch[instart+i]),numdistinctSV);
+			result.emplace_back(predict_by_cache(s,caches[i]));
+		}
+	}
+	return result;
+}
+
+template <typename T>
+std::vector<double> SVMEnsembleImpl::lazy_decision_value(const Storage<T>& s, const SparseVectorView &x, const std::function<bool(size_t,double)>& stop) const{
+	assert(models.size()>0 && "Trying to make predictions with an empty ensemble!");
+
+	prepare(s);
+	QueryBuffer buffer;
+	SparseVectorView query=stored_query(s,x,buffer);
+	if(useLinearWeights){
+		// all decision values follow from a single pass over x
+		std::vector<double> decision_vals(size(),0.0);
+		linear_decision_value(query,decision_vals);
+		for(size_t i=0,n=decision_vals.size();i<n;++i){
+			if(stop(i,decision_vals[i])){
+				decision_vals.resize(i+1);
+				break;
+			}
+		}
+		return decision_vals;
+	}
+
+	// kernel evaluations are memoized because SVs are shared between models
+	size_t numdistinctSV=s.pool.rows();
+	std::vector<double> cache(numdistinctSV,0.0);
+	std::vector<bool> cached(numdistinctSV,false);
+	double xsquare=squaredNorm(x);
+	bool innerProductBased=kernel->isInnerProductBased();
+
+	// SVs that a model needs and are not cached yet, with their inner products or kernel values
+	std::vector<unsigned> pending;
+	std::vector<double> values, squares;
+
+	std::vector<double> decision_vals;
+	decision_vals.reserve(size());
+	for(size_t i=0,n=s.coefficients.rows();i<n;++i){
+		auto row=s.coefficients.row(i);
+		pending.clear();
+		values.clear();
+		squares.clear();
+		for(size_t k=0;k<row.nnz;++k){
+			unsigned sv=row.indices[k];
+			if(cached[sv]) continue;
+			cached[sv]=true;
+			pending.push_back(sv);
+			if(innerProductBased){
+				values.push_back(inner_product(s,sv,query));
+				squares.push_back(s.squares[sv]);
+			}else{
+				values.push_back(row_k_function(s,sv,x));
+			}
+		}
+
+		// the same batched nonlinearity as fill_cache(), so kernel values equal those of decision_value()
+		if(innerProductBased && !values.empty())
+			kernel->k_function(values.data(),squares.data(),xsquare,values.size());
+		for(size_t k=0;k<pending.size();++k)
+			cache[pending[k]]=values[k];
+
+		double sum=0.0;
+		for(size_t k=0;k<row.nnz;++k)
+			sum+=row.values[k]*cache[row.indices[k]];
+		decision_vals.push_back(sum-rhos[i]);
+		if(stop(i,decision_vals.back()))
+			break;
+	}
+	return decision_vals;
+}
+
+std::unique_ptr<SVMModel> SVMEnsembleImpl::combine(const std::vector<double>& coeffs, double offset) const{
+	assert((coeffs.size()==1 || coeffs.size()==size()) && "Number of coefficients does not match ensemble size!");
+
+	// fold coeffs into the dual coefficients of the distinct SVs, taken from the models in double precision
+	std::vector<double> combined(numDistinctSV(),0.0);
+	double rho=-offset;
+	for(size_t i=0,n=models.size();i<n;++i){
+		double c = coeffs.size()==1 ? coeffs[0] : coeffs[i];
+		SVMModel::const_weight_iter Iw=models[i].first->weight_begin();
+		for(unsigned j=0;j<models[i].first->size();++j)
+			combined[SVindex[models[i].second+j]]+=c*Iw[j];
+		rho+=c*rhos[i];
+	}
+
+	SVMModel::SV_container SVs;
+	SVMModel::Weights weights;
+	for(size_t k=0;k<combined.size();++k){
+		if(combined[k]==0.0) continue;
+		SVs.push_back(svJumpTable[k]);
+		weights.push_back(combined[k]);
 	}
 
-	for(unsigned i=0;i<numdistinctSV;++i)
-		cache.emplace_back(kernel->k_function(denseSVs[i].begin(),denseSVs[i].end(),x.begin(),x.end()));
+	// all SVs are attributed to the positive class, like LibSVM::convert does for linear models
+	SVMModel::Classes classes;
+	classes.emplace_back(positive_label(),SVs.size());
+	classes.emplace_back(negative_label(),0);
 
-	return predict_by_cache(cache);
+	return std::unique_ptr<SVMModel>(new SVMModel(std::move(SVs),std::move(weights),std::move(classes),
+			std::vector<double>(1,rho),kernel->clone()));
 }
 
+unique_ptr<SVMEnsembleImpl> SVMEnsembleImpl::merged(double tolerance, const SVMEnsemble* ens) const{
+	size_t numSV=numDistinctSV();
+
+	// SVs are projected onto a fixed random unit direction u. Since |u'(a-b)| <= ||a-b||,
+	// only SVs with projections within <tolerance> of each other can be merged.
+	unsigned maxidx=0;
+	for(size_t k=0;k<numSV;++k)
+		maxidx=std::max(maxidx,svJumpTable[k]->size());
+	std::vector<double> direction(maxidx,0.0);
+	std::mt19937 rng(0);
+	std::normal_distribution<double> normal;
+	for(double& u: direction) u=normal(rng);
+	double norm=std::sqrt(squaredNorm(direction.data(),direction.size()));
+	for(double& u: direction) u/=norm;
+
+	std::vector<double> projections(numSV);
+	for(size_t k=0;k<numSV;++k)
+		projections[k]=InnerProduct(direction,*svJumpTable[k]);
+	std::vector<size_t> order(numSV);
+	std::iota(order.begin(),order.end(),0);
+	std::sort(order.begin(),order.end(),[&](size_t a, size_t b){ return projections[a]<projections[b]; });
+
+	// greedy leader clustering: each SV joins the first representative within range, or becomes one
+	std::vector<size_t> representative(numSV);
+	std::vector<size_t> leaders;	// in order of increasing projection
+	double sqtolerance=tolerance*tolerance;
+	for(size_t k: order){
+		representative[k]=k;
+		for(std::vector<size_t>::const_reverse_iterator I=leaders.rbegin(),E=leaders.rend();
+				I!=E && projections[*I]>=projections[k]-tolerance;++I){
+			if(squaredDistance(*svJumpTable[*I],*svJumpTable[k])<=sqtolerance){
+				representative[k]=*I;
+				break;
+			}
+		}
+		if(representative[k]==k) leaders.push_back(k);
+	}
+
+	// rebuild all models on the representatives, SVs of the same class that share
+	// a representative are merged into one by summing their coefficients
+	unique_ptr<SVMEnsembleImpl> result(new SVMEnsembleImpl(kernel->clone(),labelmap));
+	for(const_iterator I=begin(),E=end();I!=E;++I){
+		const SVMModel* model=I->first;
+		SVMModel::const_weight_iter Iw=model->weight_begin();
+
+		SVMModel::SV_container SVs;
+		SVMModel::Weights weights;
+		SVMModel::Classes classes;
+		unsigned localidx=0;
+		for(unsigned c=0;c<model->getNumClasses();++c){
+			std::map<size_t,size_t> positions;
+			size_t start=SVs.size();
+			for(unsigned j=0;j<model->getNumSV(c);++j,++localidx){
+				size_t rep=representative[SVindex[I->second+localidx]];
+				std::pair<std::map<size_t,size_t>::iterator,bool> insertion=positions.insert(std::make_pair(rep,SVs.size()));
+				if(insertion.second){
+					SVs.push_back(svJumpTable[rep]);
+					weights.push_back(Iw[localidx]);
+				}else{
+					weights[insertion.first->second]+=Iw[localidx];
+				}
+			}
+			classes.emplace_back(model->getLabel(c),SVs.size()-start);
+		}
+
+		result->add(unique_ptr<SVMModel>(new SVMModel(std::move(SVs),std::move(weights),std::move(classes),
+				std::vector<double>(model->getConstants()),kernel->clone())),ens);
+	}
+	return result;
+}
 
 unsigned SVMEnsembleImpl::getSVindex(unsigned ensembleidx) const{
 	return SVindex.at(ensembleidx);
@@ -431,9 +1739,9 @@ void SVMEnsembleImpl::printSV(std::ostream &os, int SVidx) const{
 
 // fixme: inefficient
 unsigned SVMEnsembleImpl::getSVindex(unsigned localidx, const SVMModel* const mod) const{
-	modelCont::const_iterator F=models.find(const_cast<SVMModel* const>(mod));
-	assert(F!=models.end() && "Model not found in Ensemble!");
-	return SVindex.at(localidx+F->second);
+	std::map<const SVMModel*,unsigned>::const_iterator F=modelPositions.find(mod);
+	assert(F!=modelPositions.end() && "Model not found in Ensemble!");
+	return SVindex.at(localidx+models[F->second].second);
 }
 
 /**
@@ -453,6 +1761,8 @@ unique_ptr<SVMEnsemble> SVMEnsembleImpl::read(std::istream &iss){
 	std::istringstream liness(line);
 	key.clear();
 	liness >> key;
+	if(key.compare("binary")==0)
+		return read_binary(iss,liness);
 	if(key.compare("num_distinct_sv")!=0) // invalid model file!
 		exit_with_err("Invalid ensemble SVM model: num_distinct_sv not specified.");
 	liness >> numsv;
@@ -485,6 +1795,39 @@ unique_ptr<SVMEnsemble> SVMEnsembleImpl::read(std::istream &iss){
 		liness >> key;
 	}
 
+	// (optional) read precision of the prediction structures: "precision single"
+	bool singlePrecision=false;
+	if(key.compare("precision")==0){
+		std::string precision;
+		liness >> precision;
+		if(precision.compare("single")==0) singlePrecision=true;
+		else if(precision.compare("double")!=0)
+			exit_with_err(std::string("Invalid ensemble SVM model: unknown precision ")+precision);
+
+		getline(iss,line);
+		liness.clear();
+		liness.str(line);
+		key.clear();
+		liness >> key;
+	}
+
+	// (optional) read the encoding of SV values in binary format: "encoding <name>"
+	SVMEnsemble::ValueEncoding encoding=SVMEnsemble::DOUBLE_VALUES;
+	if(key.compare("encoding")==0){
+		std::string name;
+		liness >> name;
+		const char **found=std::find(std::begin(ENCODING_NAMES),std::end(ENCODING_NAMES),name);
+		if(found==std::end(ENCODING_NAMES))
+			exit_with_err(std::string("Invalid ensemble SVM model: unknown encoding ")+name);
+		encoding=static_cast<SVMEnsemble::ValueEncoding>(found-std::begin(ENCODING_NAMES));
+
+		getline(iss,line);
+		liness.clear();
+		liness.str(line);
+		key.clear();
+		liness >> key;
+	}
+
 	// read num_models
 	if(key.compare("num_models")!=0) // invalid model file!
 		exit_with_err(std::string("Invalid ensemble SVM model: num_models not specified. Got: ")+key);
@@ -504,13 +1847,59 @@ unique_ptr<SVMEnsemble> SVMEnsembleImpl::read(std::istream &iss){
 		ens.reset(new SVMEnsembleImpl(std::move(kernel),map));
 	else
 		ens.reset(new SVMEnsembleImpl(std::move(kernel)));
-
-	for(unsigned i=0;i<numsv;++i){
-		unique_ptr<SparseVector> sv=SparseVector::read(iss);
-		ens->svJumpTable.emplace_back(sv.get());
-		ens->supportVectors.insert(std::make_pair(sv.get(),i));
-		sv.release();
+	ens->set_single_precision(singlePrecision);
+	ens->encoding=encoding;	// values in text are already rounded
+
+	// large ensembles in memory are split into independent SVs and models, which are parsed in parallel
+	// the sequential path below handles the rest, including malformed input
+	MemoryStreamBuffer *memory=dynamic_cast<MemoryStreamBuffer*>(iss.rdbuf());
+	TextSections sections;
+#ifdef HAVE_PTHREAD
+	unsigned numthreads = readThreads ? readThreads : std::thread::hardware_concurrency();
+	std::unique_ptr<WorkerTeam> team;
+	if(memory && numthreads>1 && memory->remaining()>=PARALLEL_READ_BYTES
+			&& sections.scan(memory->position(),memory->position()+memory->remaining(),numsv,nummodels))
+		team.reset(new WorkerTeam(numthreads));
+#endif
+
+	// SVs are read before they are appended, so all containers can be allocated once
+	size_t nnz=0;
+#ifdef HAVE_PTHREAD
+	if(team){
+		SVDeque& svs=ens->svJumpTable;
+		svs.resize(numsv);
+		size_t parts=std::min<size_t>(numsv,team->num_threads()*RANGES_PER_THREAD);
+		auto readSVs=[&](size_t part){
+			size_t first=part*numsv/parts, last=(part+1)*numsv/parts;
+			MemoryStreamBuffer buffer(sections.svs[first],sections.svs[last]-sections.svs[first]);
+			std::istream is(&buffer);
+			TextScanner scanner(is);
+			for(size_t i=first;i<last;++i)
+				svs[i].reset(SparseVector::read(scanner).release());
+		};
+		team->run(readSVs,parts);
+		for(unsigned i=0;i<numsv;++i)
+			nnz+=svs[i]->numNonzero();
+		memory->skip(sections.svs[numsv]-memory->position());
 	}
+#endif
+	for(unsigned i=ens->svJumpTable.size();i<numsv;++i){
+		ens->svJumpTable.emplace_back(SparseVector::read(iss).release());
+		nnz+=ens->svJumpTable.back()->numNonzero();
+	}
+	// int8 scales follow from all SVs, so they are known before the SVs are appended
+	ens->select_storage();
+	ens->reserveSV(numsv,nnz);
+	for(unsigned i=0;i<numsv;++i)
+		ens->appendSV(*ens->svJumpTable[i]);
+	ens->models.reserve(nummodels);
+	ens->rhos.reserve(nummodels);
+
+	// models refer to the SVs read above, their indices are found by address
+	SVMEnsembleImpl *impl=ens.get();
+	std::unordered_map<const SparseVector*,unsigned> positions(numsv);
+	for(unsigned i=0;i<numsv;++i)
+		positions.insert(std::make_pair(impl->svJumpTable[i].get(),i));
 
 	unique_ptr<SVMEnsemble> ensemble(new SVMEnsemble(std::move(ens)));
 
@@ -520,9 +1909,31 @@ unique_ptr<SVMEnsemble> SVMEnsembleImpl::read(std::istream &iss){
 	if(line.compare("*** MODELS ***")!=0) // invalid model file!
 		exit_with_err("Invalid ensemble SVM model: start of models at wrong position.");
 
+	// models only look up SVs in the ensemble, so they can be parsed in parallel and added in order
+	std::vector<unique_ptr<SVMModel>> parsed;
+#ifdef HAVE_PTHREAD
+	if(team && nummodels){
+		parsed.resize(nummodels);
+		const char *end=memory->position()+memory->remaining(), *last=end;
+		auto readModels=[&](size_t i){
+			const char *stop = i+1<nummodels ? sections.models[i+1] : end;
+			MemoryStreamBuffer buffer(sections.models[i],stop-sections.models[i]);
+			std::istream is(&buffer);
+			parsed[i]=SVMModel::read(is,ensemble.get());
+			if(i+1==nummodels) last=buffer.position();
+		};
+		team->run(readModels,nummodels);
+		memory->skip(last-memory->position());
+	}
+#endif
+
+	std::vector<unsigned> svidx;
 	for(unsigned i=0;i<nummodels;++i){
-		unique_ptr<SVMModel> model=SVMModel::read(iss,ensemble.get()); // fixme: use factory?
-		ensemble->add(std::move(model));
+		unique_ptr<SVMModel> model = parsed.empty() ? SVMModel::read(iss,ensemble.get()) : std::move(parsed[i]); // fixme: use factory?
+		svidx.clear();
+		for(SVMModel::const_iterator I=model->begin(),E=model->end();I!=E;++I)
+			svidx.push_back(positions[I->get()]);
+		impl->add(std::move(model),ensemble.get(),svidx.data());
 	}
 
 	return std::move(ensemble);
@@ -541,17 +1952,450 @@ void SVMEnsembleImpl::serialize(std::ostream& os) const{
 		os << std::endl;
 	}
 
+	if(singlePrecision)
+		os << "precision single" << std::endl;
+	if(encoding!=SVMEnsemble::DOUBLE_VALUES)
+		os << "encoding " << ENCODING_NAMES[encoding] << std::endl;
+
 	os << "num_models " << size() << std::endl;
 	os << *getKernel();
 	os << "*** SV ***" << std::endl;
-	for(SVMEnsembleImpl::sv_const_iterator I=sv_begin(),E=sv_end();I!=E;++I)
-		os << **I << std::endl;
+	for(SVMEnsembleImpl::sv_const_iterator I=sv_begin(),E=sv_end();I!=E;++I){
+		if(encoding==SVMEnsemble::DOUBLE_VALUES) os << **I << std::endl;
+		else{
+			write_rounded(os,quantized(**I));
+			os << std::endl;
+		}
+	}
 	os << "*** MODELS ***" << std::endl;
 	for(SVMEnsembleImpl::const_iterator I=begin(),E=end();I!=E;++I){
 		os << *I->first;
 	}
 }
 
+void SVMEnsembleImpl::serialize_binary(std::ostream& os) const{
+	// kernel, label map and classes are small, they remain in text
+	std::ostringstream text;
+	text.precision(PRECISION);
+	text << *getKernel();
+	text << "labelmap";
+	for(LabelMap::const_iterator I=labelmap.begin(),E=labelmap.end();I!=E;++I)
+		text << " " << I->first << " " << I->second;
+	text << std::endl;
+	for(const_iterator I=begin(),E=end();I!=E;++I){
+		const SVMModel& model=*I->first;
+		text << model.getNumClasses();
+		for(unsigned i=0;i<model.getNumClasses();++i)
+			text << " " << model.getLabel(i) << " " << model.getNumSV(i);
+		text << std::endl;
+	}
+	std::string textsection=text.str();
+
+	// values are stored in the narrowest type of the encoding, int8 values relative to their feature's scale
+	std::vector<uint64_t> svoffsets(1,0), indexoffsets(1,0);
+	std::vector<uint8_t> svindices;
+	std::vector<double> doublevalues, scales, featurescales;
+	std::vector<uint32_t> features;
+	std::vector<float> floatvalues;
+	std::vector<uint16_t> halfvalues;
+	std::vector<int8_t> int8values;
+	if(encoding==SVMEnsemble::INT8_VALUES){
+		scales = int8Scales;
+		for(size_t f=0;f<scales.size();++f){
+			if(scales[f]==0.0) continue;
+			features.push_back(f);
+			featurescales.push_back(scales[f]);
+		}
+	}
+	svoffsets.reserve(numDistinctSV()+1);
+	for(sv_const_iterator I=sv_begin(),E=sv_end();I!=E;++I){
+		unsigned previous=0;
+		for(SparseVector::const_iterator Isv=(*I)->begin(),Esv=(*I)->end();Isv!=Esv;++Isv){
+			assert(Isv->first>=previous && "SV indices must be sorted!");
+			write_varint(svindices,Isv->first-previous);
+			previous=Isv->first;
+			switch(encoding){
+			case SVMEnsemble::FLOAT_VALUES: floatvalues.push_back(Isv->second); break;
+			case SVMEnsemble::HALF_VALUES: halfvalues.push_back(to_half(Isv->second)); break;
+			case SVMEnsemble::INT8_VALUES: int8values.push_back(to_int8(Isv->second,scales[Isv->first])); break;
+			default: doublevalues.push_back(Isv->second);
+			}
+		}
+		svoffsets.push_back(svoffsets.back()+(*I)->numNonzero());
+		indexoffsets.push_back(svindices.size());
+	}
+	std::pair<const char*,uint64_t> svvalues;
+	switch(encoding){
+	case SVMEnsemble::FLOAT_VALUES: svvalues={reinterpret_cast<const char*>(floatvalues.data()),floatvalues.size()*sizeof(float)}; break;
+	case SVMEnsemble::HALF_VALUES: svvalues={reinterpret_cast<const char*>(halfvalues.data()),halfvalues.size()*sizeof(uint16_t)}; break;
+	case SVMEnsemble::INT8_VALUES: svvalues={reinterpret_cast<const char*>(int8values.data()),int8values.size()}; break;
+	default: svvalues={reinterpret_cast<const char*>(doublevalues.data()),doublevalues.size()*sizeof(double)};
+	}
+
+	std::vector<uint64_t> modeloffsets(1,0);
+	std::vector<uint32_t> modelsvs;
+	std::vector<double> weights, constants;
+	modeloffsets.reserve(size()+1);
+	for(const_iterator I=begin(),E=end();I!=E;++I){
+		const SVMModel& model=*I->first;
+		unsigned k=model.getNumClasses();
+		for(unsigned j=0;j<model.size();++j)
+			modelsvs.push_back(SVindex[I->second+j]);
+		modeloffsets.push_back(modelsvs.size());
+		weights.insert(weights.end(),model.weight_begin(),model.weight_begin()+model.size()*(k-1));
+		for(unsigned i=0;i<k*(k-1)/2;++i)
+			constants.push_back(model.getConstant(i));
+	}
+
+	const std::pair<const char*,uint64_t> sections[NUM_SECTIONS]={
+		{textsection.data(),textsection.size()},
+		{reinterpret_cast<const char*>(svoffsets.data()),svoffsets.size()*sizeof(uint64_t)},
+		{reinterpret_cast<const char*>(svindices.data()),svindices.size()},
+		svvalues,
+		{reinterpret_cast<const char*>(modeloffsets.data()),modeloffsets.size()*sizeof(uint64_t)},
+		{reinterpret_cast<const char*>(modelsvs.data()),modelsvs.size()*sizeof(uint32_t)},
+		{reinterpret_cast<const char*>(weights.data()),weights.size()*sizeof(double)},
+		{reinterpret_cast<const char*>(constants.data()),constants.size()*sizeof(double)},
+		{reinterpret_cast<const char*>(features.data()),features.size()*sizeof(uint32_t)},
+		{reinterpret_cast<const char*>(featurescales.data()),featurescales.size()*sizeof(double)},
+		{reinterpret_cast<const char*>(indexoffsets.data()),indexoffsets.size()*sizeof(uint64_t)}
+	};
+
+	std::vector<uint64_t> header(HEADER_WORDS+2*NUM_SECTIONS,0);
+	header[MAGIC]=BINARY_MAGIC;
+	header[FLAGS]=(singlePrecision ? SINGLE_PRECISION_FLAG : 0) | uint64_t(encoding)<<VALUE_ENCODING_SHIFT;
+	header[NUM_SV]=numDistinctSV();
+	header[NUM_NONZERO]=svoffsets.back();
+	header[NUM_MODELS]=size();
+	uint64_t payload=header.size()*sizeof(uint64_t);
+	for(unsigned i=0;i<NUM_SECTIONS;++i){
+		header[HEADER_WORDS+2*i]=payload;
+		header[HEADER_WORDS+2*i+1]=sections[i].second;
+		payload=binary_align(payload+sections[i].second);
+	}
+
+	// the payload is padded to an aligned position in the stream, so it can be decoded without copying once mapped
+	os << "SVMEnsemble" << std::endl;
+	std::ostringstream line;
+	line << "binary " << BINARY_VERSION << " " << payload << " ";
+	std::streamoff position=os.tellp();
+	unsigned padding=0;
+	if(position>=0)
+		padding=binary_align(position+line.str().size()+2)-(position+line.str().size()+2);
+	os << line.str() << padding << "\n";
+
+	const char zeros[BINARY_ALIGNMENT]={0};
+	os.write(zeros,padding);
+	os.write(reinterpret_cast<const char*>(header.data()),header.size()*sizeof(uint64_t));
+	uint64_t written=header.size()*sizeof(uint64_t);
+	for(unsigned i=0;i<NUM_SECTIONS;++i){
+		os.write(zeros,header[HEADER_WORDS+2*i]-written);
+		os.write(sections[i].first,sections[i].second);
+		written=header[HEADER_WORDS+2*i]+sections[i].second;
+	}
+	os.write(zeros,payload-written);
+}
+
+unique_ptr<SVMEnsemble> SVMEnsembleImpl::read_binary(std::istream &iss, std::istream &headerline, const std::vector<unsigned> *selection){
+	unsigned version=0, padding=0;
+	uint64_t payload=0;
+	headerline >> version >> payload >> padding;
+	if(!headerline || version<1 || version>BINARY_VERSION)
+		exit_with_err("Invalid binary ensemble SVM model: unsupported version.");
+	unsigned numsections = version==1 ? FEATURE_INDICES : version==2 ? SV_INDEX_OFFSETS : NUM_SECTIONS;
+	iss.ignore(padding);
+
+	// decode the payload in place if the stream is backed by memory, otherwise copy it into aligned storage first
+	const char *data=nullptr;
+	std::vector<uint64_t> copy;
+	MemoryStreamBuffer *buffer=dynamic_cast<MemoryStreamBuffer*>(iss.rdbuf());
+	if(buffer && buffer->remaining()>=payload && reinterpret_cast<uintptr_t>(buffer->position())%BINARY_ALIGNMENT==0){
+		data=buffer->position();
+		buffer->skip(payload);
+	}else{
+		copy.resize(binary_align(payload)/sizeof(uint64_t));
+		iss.read(reinterpret_cast<char*>(copy.data()),payload);
+		if(static_cast<uint64_t>(iss.gcount())!=payload)
+			exit_with_err("Premature end of file while reading binary ensemble SVM model.");
+		data=reinterpret_cast<const char*>(copy.data());
+	}
+
+	const uint64_t *header=reinterpret_cast<const uint64_t*>(data);
+	if(payload<(HEADER_WORDS+2*numsections)*sizeof(uint64_t))
+		exit_with_err("Invalid binary ensemble SVM model: payload too small.");
+	if(header[MAGIC]!=BINARY_MAGIC)
+		exit_with_err("Invalid binary ensemble SVM model: written on a platform with different byte order.");
+	for(unsigned i=0;i<numsections;++i){
+		uint64_t offset=header[HEADER_WORDS+2*i], size=header[HEADER_WORDS+2*i+1];
+		if(offset%BINARY_ALIGNMENT || offset>payload || size>payload-offset)
+			exit_with_err("Invalid binary ensemble SVM model: section out of bounds.");
+	}
+	uint64_t numsv=header[NUM_SV], nnz=header[NUM_NONZERO], nummodels=header[NUM_MODELS];
+
+	// kernel, label map and classes
+	MemoryStreamBuffer textbuffer(data+header[HEADER_WORDS+2*TEXT],header[HEADER_WORDS+2*TEXT+1]);
+	std::istream text(&textbuffer);
+	unique_ptr<Kernel> kernel=Kernel::read(text);
+
+	std::string line, key;
+	getline(text,line);
+	std::istringstream liness(line);
+	liness >> key;
+	if(key.compare("labelmap")!=0)
+		exit_with_err("Invalid binary ensemble SVM model: label map not specified.");
+	SVMEnsembleImpl::LabelMap map;
+	std::string internal, external;
+	while(liness >> internal >> external)
+		map.insert(make_pair(internal,external));
+
+	std::vector<SVMModel::Classes> classes(nummodels);
+	uint64_t numweights=0, numconstants=0;
+	for(uint64_t i=0;i<nummodels;++i){
+		getline(text,line);
+		liness.clear();
+		liness.str(line);
+		unsigned k=0;
+		liness >> k;
+		if(k<2)
+			exit_with_err("Invalid binary ensemble SVM model: models require at least two classes.");
+		unsigned numSV=0;
+		for(unsigned j=0;j<k;++j){
+			std::string label;
+			unsigned count;
+			if(!(liness >> label >> count))
+				exit_with_err("Invalid binary ensemble SVM model: incomplete classes.");
+			classes[i].push_back(std::make_pair(label,count));
+			numSV+=count;
+		}
+		numweights+=uint64_t(numSV)*(k-1);
+		numconstants+=k*(k-1)/2;
+	}
+
+	uint64_t encoding=header[FLAGS]>>VALUE_ENCODING_SHIFT;
+	if(encoding>SVMEnsemble::INT8_VALUES || (version==1 && encoding!=SVMEnsemble::DOUBLE_VALUES))
+		exit_with_err("Invalid binary ensemble SVM model: unknown value encoding.");
+	const uint64_t *svoffsets=binary_section<uint64_t>(data,header,SV_OFFSETS,numsv+1);
+	const uint8_t *svindices=binary_section<uint8_t>(data,header,SV_INDICES,header[HEADER_WORDS+2*SV_INDICES+1]);
+	const uint8_t *svindicesend=svindices+header[HEADER_WORDS+2*SV_INDICES+1];
+	const uint32_t *svindices32 = version==1 ? binary_section<uint32_t>(data,header,SV_INDICES,nnz) : nullptr;
+	const void *svvalues=nullptr;
+	switch(encoding){
+	case SVMEnsemble::FLOAT_VALUES: svvalues=binary_section<float>(data,header,SV_VALUES,nnz); break;
+	case SVMEnsemble::HALF_VALUES: svvalues=binary_section<uint16_t>(data,header,SV_VALUES,nnz); break;
+	case SVMEnsemble::INT8_VALUES: svvalues=binary_section<int8_t>(data,header,SV_VALUES,nnz); break;
+	default: svvalues=binary_section<double>(data,header,SV_VALUES,nnz);
+	}
+	std::vector<double> scales;
+	if(version>1){
+		uint64_t numfeatures=header[HEADER_WORDS+2*FEATURE_INDICES+1]/sizeof(uint32_t);
+		const uint32_t *features=binary_section<uint32_t>(data,header,FEATURE_INDICES,numfeatures);
+		const double *featurescales=binary_section<double>(data,header,FEATURE_SCALES,numfeatures);
+		for(uint64_t f=0;f<numfeatures;++f){
+			if(features[f]>=scales.size()) scales.resize(features[f]+1,0.0);
+			scales[features[f]]=featurescales[f];
+		}
+	}
+	const uint64_t *modeloffsets=binary_section<uint64_t>(data,header,MODEL_OFFSETS,nummodels+1);
+	const uint32_t *modelsvs=binary_section<uint32_t>(data,header,MODEL_SVS,modeloffsets[nummodels]);
+	const double *weights=binary_section<double>(data,header,MODEL_WEIGHTS,numweights);
+	const double *constants=binary_section<double>(data,header,MODEL_CONSTANTS,numconstants);
+
+	// offsets of the weights and constants of each model follow from the classes
+	std::vector<uint64_t> weightoffsets(nummodels+1,0), constantoffsets(nummodels+1,0);
+	for(uint64_t i=0;i<nummodels;++i){
+		unsigned k=classes[i].size(), numSV=0;
+		for(unsigned j=0;j<k;++j)
+			numSV+=classes[i][j].second;
+		if(modeloffsets[i]>modeloffsets[i+1] || modeloffsets[i+1]-modeloffsets[i]!=numSV)
+			exit_with_err("Invalid binary ensemble SVM model: model offsets do not match the classes.");
+		weightoffsets[i+1]=weightoffsets[i]+uint64_t(numSV)*(k-1);
+		constantoffsets[i+1]=constantoffsets[i]+k*(k-1)/2;
+	}
+
+	// a selection of models only needs the SVs it refers to, which keep their order
+	std::vector<uint64_t> selected;
+	std::vector<uint32_t> svs;
+	if(selection){
+		for(unsigned m: *selection){
+			if(m>=nummodels)
+				exit_with_err("Invalid selection of base models: index out of bounds.");
+			selected.push_back(m);
+			svs.insert(svs.end(),modelsvs+modeloffsets[m],modelsvs+modeloffsets[m+1]);
+		}
+		std::sort(svs.begin(),svs.end());
+		svs.erase(std::unique(svs.begin(),svs.end()),svs.end());
+	}else{
+		selected.resize(nummodels);
+		std::iota(selected.begin(),selected.end(),0);
+		svs.resize(numsv);
+		std::iota(svs.begin(),svs.end(),0);
+	}
+	if(!svs.empty() && svs.back()>=numsv)
+		exit_with_err("Invalid binary ensemble SVM model: SV index out of bounds.");
+
+	// indices of selected SVs are found via SV_INDEX_OFFSETS, version 2 lacks it and is scanned instead
+	uint64_t indexbytes=header[HEADER_WORDS+2*SV_INDICES+1];
+	const uint64_t *indexoffsets=nullptr;
+	std::vector<uint64_t> scanned;
+	if(selection && version>2){
+		indexoffsets=binary_section<uint64_t>(data,header,SV_INDEX_OFFSETS,numsv+1);
+	}else if(selection && version==2){
+		scanned.resize(numsv);
+		const uint8_t *pos=svindices;
+		for(uint64_t i=0;i<numsv;++i){
+			scanned[i]=pos-svindices;
+			uint32_t difference;
+			for(uint64_t j=svoffsets[i];j<svoffsets[i+1];++j){
+				if(!read_varint(pos,svindicesend,difference))
+					exit_with_err("Invalid binary ensemble SVM model: SV indices out of bounds.");
+			}
+		}
+		indexoffsets=scanned.data();
+	}
+
+	uint64_t numnonzero=0;
+	for(uint32_t i: svs){
+		if(svoffsets[i]>svoffsets[i+1] || svoffsets[i+1]>nnz)
+			exit_with_err("Invalid binary ensemble SVM model: SV offsets out of bounds.");
+		numnonzero+=svoffsets[i+1]-svoffsets[i];
+	}
+
+	unique_ptr<SVMEnsembleImpl> ens(map.empty() ? new SVMEnsembleImpl(std::move(kernel))
+			: new SVMEnsembleImpl(std::move(kernel),map));
+	SVMEnsembleImpl *impl=ens.get();
+	impl->set_single_precision(header[FLAGS] & SINGLE_PRECISION_FLAG);
+	impl->encoding=static_cast<SVMEnsemble::ValueEncoding>(encoding);
+	impl->select_storage(scales);
+	impl->reserveSV(svs.size(),numnonzero);
+	impl->models.reserve(selected.size());
+	impl->rhos.reserve(selected.size());
+
+	const uint8_t *next=svindices;	// indices of the next SV when all SVs are read
+	for(uint32_t i: svs){
+		const uint8_t *pos=next;
+		if(indexoffsets){
+			if(indexoffsets[i]>indexbytes)
+				exit_with_err("Invalid binary ensemble SVM model: SV indices out of bounds.");
+			pos=svindices+indexoffsets[i];
+		}
+
+		SparseVector::SparseSV content;
+		content.reserve(svoffsets[i+1]-svoffsets[i]);
+		uint32_t index=0;
+		for(uint64_t j=svoffsets[i];j<svoffsets[i+1];++j){
+			uint32_t difference;
+			if(svindices32) index=svindices32[j];
+			else if(read_varint(pos,svindicesend,difference)) index+=difference;
+			else exit_with_err("Invalid binary ensemble SVM model: SV indices out of bounds.");
+
+			double value;
+			switch(encoding){
+			case SVMEnsemble::FLOAT_VALUES: value=static_cast<const float*>(svvalues)[j]; break;
+			case SVMEnsemble::HALF_VALUES: value=from_half(static_cast<const uint16_t*>(svvalues)[j]); break;
+			case SVMEnsemble::INT8_VALUES:
+				// features without scale only have zeros
+				value = index<scales.size() ? static_cast<const int8_t*>(svvalues)[j]*scales[index] : 0.0;
+				break;
+			default: value=static_cast<const double*>(svvalues)[j];
+			}
+			content.emplace_back(index,value);
+		}
+		next=pos;
+
+		unique_ptr<SparseVector> sv(new SparseVector(std::move(content)));
+		impl->appendSV(*sv);
+		impl->svJumpTable.emplace_back(sv.get());
+		sv.release();
+	}
+
+	unique_ptr<SVMEnsemble> ensemble(new SVMEnsemble(std::move(ens)));
+
+	// SV indices are known, so models are added without looking up their SVs
+	std::vector<uint32_t> renumbered;
+	for(uint64_t i: selected){
+		unsigned numSV=modeloffsets[i+1]-modeloffsets[i];
+		const uint32_t *svidx=modelsvs+modeloffsets[i];
+		if(selection){
+			renumbered.clear();
+			for(unsigned j=0;j<numSV;++j)
+				renumbered.push_back(std::lower_bound(svs.begin(),svs.end(),svidx[j])-svs.begin());
+			svidx=renumbered.data();
+		}
+
+		SVMModel::SV_container SVs;
+		SVs.reserve(numSV);
+		for(unsigned j=0;j<numSV;++j)
+			SVs.push_back(impl->svJumpTable[svidx[j]]);
+
+		SVMModel::Weights w(weights+weightoffsets[i],weights+weightoffsets[i+1]);
+		std::vector<double> c(constants+constantoffsets[i],constants+constantoffsets[i+1]);
+
+		unique_ptr<SVMModel> model(new SVMModel(std::move(SVs),std::move(w),SVMModel::Classes(classes[i]),std::move(c),ensemble.get()));
+		impl->add(std::move(model),ensemble.get(),svidx);
+	}
+
+	return ensemble;
+}
+
+unique_ptr<SVMEnsemble> SVMEnsembleImpl::load(const std::string &fname, const std::vector<unsigned>& selection){
+	MappedFile file(fname);
+	if(!file.is_open())
+		exit_with_err(std::string("Unable to open file ")+fname);
+
+	// the ensemble may be part of e.g. a BinaryWorkflow, its first line is found without parsing what precedes it
+	const char *pos=file.data(), *end=file.data()+file.size();
+	while(pos!=end && !is_line(pos,end,"SVMEnsemble"))
+		pos=skip_line(pos,end);
+	if(pos==end)
+		exit_with_err(std::string("No SVM ensemble found in ")+fname);
+	pos=skip_line(pos,end);
+
+	MemoryStreamBuffer buffer(pos,end-pos);
+	std::istream is(&buffer);
+	std::string line, key;
+	getline(is,line);
+	std::istringstream liness(line);
+	liness >> key;
+	if(key.compare("binary")==0)
+		return read_binary(is,liness,&selection);
+
+	// text ensembles are read entirely
+	MemoryStreamBuffer text(pos,end-pos);
+	std::istream textstream(&text);
+	unique_ptr<SVMEnsemble> ensemble=read(textstream);
+	bool singlePrecision=ensemble->pImpl->single_precision();
+	SVMEnsemble::ValueEncoding encoding=ensemble->pImpl->value_encoding();
+	std::vector<double> scales=ensemble->pImpl->int8Scales;
+	ensemble->pImpl=ensemble->pImpl->selected(selection,ensemble.get());
+	ensemble->pImpl->set_single_precision(singlePrecision);
+	ensemble->pImpl->encoding=encoding;
+	if(encoding==SVMEnsemble::INT8_VALUES){
+		// the selected SVs keep the levels they were read with
+		ensemble->pImpl->select_storage(std::move(scales));
+		ensemble->pImpl->rebuild();
+	}
+	return ensemble;
+}
+
+unique_ptr<SVMEnsembleImpl> SVMEnsembleImpl::selected(const std::vector<unsigned>& selection, const SVMEnsemble* ens) const{
+	unique_ptr<SVMEnsembleImpl> result(new SVMEnsembleImpl(kernel->clone(),labelmap));
+	for(unsigned m: selection){
+		if(m>=size())
+			exit_with_err("Invalid selection of base models: index out of bounds.");
+		const SVMModel* model=models[m].first;
+
+		SVMModel::SV_container SVs(model->begin(),model->end());
+		SVMModel::Weights weights(model->weight_begin(),model->weight_begin()+model->size()*(model->getNumClasses()-1));
+		SVMModel::Classes classes;
+		for(unsigned c=0;c<model->getNumClasses();++c)
+			classes.emplace_back(model->getLabel(c),model->getNumSV(c));
+
+		result->add(unique_ptr<SVMModel>(new SVMModel(std::move(SVs),std::move(weights),std::move(classes),
+				std::vector<double>(model->getConstants()),kernel->clone())),ens);
+	}
+	return result;
+}
+
 //unique_ptr<SVMEnsemble> SVMEnsembleImpl::load(const string &fname){
 //	std::ifstream file(fname.c_str(),std::ios::in);
 //	unique_ptr<SVMEnsembleImpl> ensemble = SVMEnsembleImpl::read(file);
@@ -589,6 +2433,28 @@ const Kernel *SVMEnsemble::getKernel() const{
 	return pImpl->getKernel();
 }
 
+void SVMEnsemble::set_num_threads(unsigned numthreads){
+	pImpl->set_num_threads(numthreads);
+}
+
+void SVMEnsemble::set_read_threads(unsigned numthreads){
+	readThreads=numthreads;
+}
+
+void SVMEnsemble::set_single_precision(bool enable){
+	pImpl->set_single_precision(enable);
+}
+bool SVMEnsemble::single_precision() const{
+	return pImpl->single_precision();
+}
+
+void SVMEnsemble::quantize(ValueEncoding encoding){
+	pImpl->quantize(encoding);
+}
+SVMEnsemble::ValueEncoding SVMEnsemble::value_encoding() const{
+	return pImpl->value_encoding();
+}
+
 SVMEnsemble::SVMEnsemble(unique_ptr<Kernel> kernel)
 :Ensemble(),
  pImpl(new SVMEnsembleImpl(std::move(kernel)))
@@ -654,6 +2520,9 @@ size_t SVMEnsemble::num_outputs() const{
 Prediction SVMEnsemble::predict(const SparseVector &x) const{
 	return pImpl->predict(x);
 }
+Prediction SVMEnsemble::predict(const SparseVectorView &x) const{
+	return pImpl->predict(x);
+}
 
 Prediction SVMEnsemble::predict(const std::vector<double>& x) const{
 	return pImpl->predict(x);
@@ -662,9 +2531,43 @@ Prediction SVMEnsemble::predict(const std::vector<double>& x) const{
 std::vector<double> SVMEnsemble::decision_value(const SparseVector &x) const{
 	return pImpl->decision_value(x);
 }
+std::vector<double> SVMEnsemble::decision_value(const SparseVectorView &x) const{
+	return pImpl->decision_value(x);
+}
 std::vector<double> SVMEnsemble::decision_value(const std::vector<double> &x) const{
 	return pImpl->decision_value(x);
 }
+const Prediction& SVMEnsemble::predict(PredictionContext& ctx, const SparseVectorView &x) const{
+	return pImpl->predict(ctx,x);
+}
+const std::vector<double>& SVMEnsemble::decision_value(PredictionContext& ctx, const SparseVectorView &x) const{
+	return pImpl->decision_value(ctx,x);
+}
+void SVMEnsemble::reserve(PredictionContext& ctx) const{
+	pImpl->reserve(ctx);
+}
+std::vector<std::vector<double>> SVMEnsemble::decision_values(const std::vector<const SparseVector*>& batch) const{
+	return pImpl->decision_values(batch);
+}
+std::vector<double> SVMEnsemble::lazy_decision_value(const SparseVectorView &x, const std::function<bool(size_t,double)>& stop) const{
+	return pImpl->lazy_decision_value(x,stop);
+}
+
+std::unique_ptr<SVMModel> SVMEnsemble::combine(const std::vector<double>& coeffs, double offset) const{
+	return pImpl->combine(coeffs,offset);
+}
+
+size_t SVMEnsemble::merge(double tolerance){
+	size_t before=numDistinctSV();
+	unsigned numthreads=pImpl->num_threads();
+	bool singlePrecision=pImpl->single_precision();
+	ValueEncoding encoding=pImpl->value_encoding();
+	pImpl=pImpl->merged(tolerance,this);
+	pImpl->set_num_threads(numthreads);
+	pImpl->set_single_precision(singlePrecision);
+	pImpl->quantize(encoding);
+	return before-numDistinctSV();
+}
 
 unsigned SVMEnsemble::getSVindex(unsigned ensembleidx) const{
 	return pImpl->getSVindex(ensembleidx);
@@ -696,6 +2599,10 @@ void SVMEnsemble::serialize(std::ostream& os) const{
 	pImpl->serialize(os);
 }
 
+void SVMEnsemble::serialize_binary(std::ostream& os) const{
+	pImpl->serialize_binary(os);
+}
+
 std::ostream &operator<<(std::ostream &os, const SVMEnsemble &ens){
 	ens.serialize(os);
 	return os;
@@ -708,4 +2615,8 @@ unique_ptr<SVMEnsemble> SVMEnsemble::load(const string &fname){
 	return ensemble;
 }
 
+unique_ptr<SVMEnsemble> SVMEnsemble::load(const string &fname, const std::vector<unsigned>& selection){
+	return SVMEnsembleImpl::load(fname,selection);
+}
+
 } // ensemble namespace
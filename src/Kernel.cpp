@@ -34,6 +34,7 @@
 #include <iterator>
 #include <numeric>
 #include <cmath>
+#include <algorithm>
 
 using std::string;
 
@@ -48,6 +49,44 @@ std::string RBF_STR{"rbf"};
 std::string SIGMOID_STR{"sigmoid"};
 std::string USERDEF_STR{"userdef"};
 
+typedef ensemble::Kernel::const_iterator const_iterator;
+
+/**
+ * Integer power by repeated squaring, as in LibSVM.
+ */
+double powi(double base, unsigned times){
+	double tmp=base, ret=1.0;
+	for(unsigned t=times;t>0;t/=2){
+		if(t%2==1) ret*=tmp;
+		tmp*=tmp;
+	}
+	return ret;
+}
+
+/**
+ * Inner product over the overlapping part of two dense ranges.
+ */
+double dense_inner(const_iterator Ix, const_iterator Ex, const_iterator Iy, const_iterator Ey){
+	size_t n=std::min(std::distance(Ix,Ex),std::distance(Iy,Ey));
+	if(n==0) return 0.0;
+	return ensemble::InnerProduct(&*Ix,&*Iy,n);
+}
+
+/**
+ * Squared Euclidean distance between two dense ranges, the shortest is padded with zeros.
+ */
+double dense_sqdist(const_iterator Ix, const_iterator Ex, const_iterator Iy, const_iterator Ey){
+	size_t distx=std::distance(Ix,Ex), disty=std::distance(Iy,Ey);
+	if(distx > disty){
+		std::swap(Ix,Iy);
+		std::swap(Ex,Ey);
+		std::swap(distx,disty);
+	}
+	double nonoverlap = disty > distx ? ensemble::squaredNorm(&*(Iy+distx),disty-distx) : 0.0;
+	if(distx==0) return nonoverlap;
+	return ensemble::squaredDistance(&*Ix,&*Iy,distx)+nonoverlap;
+}
+
 }
 
 
@@ -63,6 +102,15 @@ bool Kernel::operator==(const Kernel &other) const{
 bool Kernel::operator!=(const Kernel &other) const{
 	return !(operator ==(other));
 }
+double Kernel::k_function(double inner, double xsquare, double ysquare) const{
+	exit_with_err("Kernel cannot be computed based on inner products.");
+	return 0.0;
+}
+void Kernel::k_function(double *inner, const double *ysquares, double xsquare, size_t n) const{
+	for(size_t i=0;i<n;++i)
+		inner[i]=k_function(inner[i],xsquare,ysquares[i]);
+}
+bool Kernel::isInnerProductBased() const{ return false; }
 
 // LINEARKERNEL FUNCTIONS
 LinearKernel::LinearKernel():Kernel(KERNEL_TYPES::LINEAR){}
@@ -70,10 +118,19 @@ double LinearKernel::k_function(const SparseVector *x, const SparseVector *y) co
 	return InnerProduct(*x,*y);
 }
 double LinearKernel::k_function(const_iterator Ix, const_iterator Ex, const_iterator Iy, const_iterator Ey) const{
-	if(distance(Ix,Ex) <= distance(Iy,Ey))
-		return std::inner_product(Ix,Ex,Iy,0.0);
-	return std::inner_product(Iy,Ey,Ix,0.0);
+	return dense_inner(Ix,Ex,Iy,Ey);
+}
+double LinearKernel::k_function(const SparseVectorView& x, const SparseVectorView& y) const{
+	return InnerProduct(x,y);
+}
+double LinearKernel::k_function(const SparseRowF& x, const SparseVectorView& y) const{
+	return InnerProduct(x,y);
 }
+double LinearKernel::k_function(double inner, double xsquare, double ysquare) const{
+	return inner;
+}
+void LinearKernel::k_function(double *inner, const double *ysquares, double xsquare, size_t n) const{}
+bool LinearKernel::isInnerProductBased() const{ return true; }
 unique_ptr<Kernel> LinearKernel::clone() const{
 	unique_ptr<Kernel> ptr(static_cast<Kernel*>(new LinearKernel()));
 	return ptr;
@@ -95,14 +152,25 @@ unique_ptr<Kernel> PolyKernel::clone() const{
 	return ptr;
 }
 double PolyKernel::k_function(const SparseVector *x, const SparseVector *y) const{
-	//	return powi(gamma*InnerProduct(*x,*y)+coef0,degree); // LibSVM code
-	return pow(getGamma()*InnerProduct(*x,*y)+getCoef(),getDegree());
+	return powi(getGamma()*InnerProduct(*x,*y)+getCoef(),getDegree());
 }
 double PolyKernel::k_function(const_iterator Ix, const_iterator Ex, const_iterator Iy, const_iterator Ey) const{
-	if(distance(Ix,Ex) <= distance(Iy,Ey))
-		return pow(getGamma()*std::inner_product(Ix,Ex,Iy,0.0)+getCoef(),getDegree());
-	return pow(getGamma()*std::inner_product(Iy,Ey,Ix,0.0)+getCoef(),getDegree());
+	return powi(getGamma()*dense_inner(Ix,Ex,Iy,Ey)+getCoef(),getDegree());
+}
+double PolyKernel::k_function(const SparseVectorView& x, const SparseVectorView& y) const{
+	return powi(getGamma()*InnerProduct(x,y)+getCoef(),getDegree());
+}
+double PolyKernel::k_function(const SparseRowF& x, const SparseVectorView& y) const{
+	return powi(getGamma()*InnerProduct(x,y)+getCoef(),getDegree());
+}
+double PolyKernel::k_function(double inner, double xsquare, double ysquare) const{
+	return powi(getGamma()*inner+getCoef(),getDegree());
+}
+void PolyKernel::k_function(double *inner, const double *ysquares, double xsquare, size_t n) const{
+	for(size_t i=0;i<n;++i)
+		inner[i]=powi(getGamma()*inner[i]+getCoef(),getDegree());
 }
+bool PolyKernel::isInnerProductBased() const{ return true; }
 bool PolyKernel::operator==(const PolyKernel &other) const{
 	return (getGamma()==other.getGamma() && getCoef()==other.getCoef() && getDegree()==other.getDegree());
 }
@@ -158,29 +226,27 @@ double RBFKernel::k_function(const SparseVector *x, const SparseVector *y) const
 	return exp(-getGamma()*sum);
 }
 double RBFKernel::k_function(const_iterator Ix, const_iterator Ex, const_iterator Iy, const_iterator Ey) const{
-
-	size_t distx = distance(Ix,Ex), disty = distance(Iy,Ey);
-	if(distx == disty)
-		return exp(-gamma*(std::inner_product(Ix,Ex,Iy,0.0,std::plus<double>(),
-						[](double x, double y){ return std::pow(x-y,2); })));
-	if(distx < disty){
-		// used if length of x and y differ
-		double nonoverlap=std::accumulate(Iy+distx,Ey,0.0,
-				[](double x, double y){ return x+y*y;});
-
-		// rbf function
-		return exp(-gamma*(std::inner_product(Ix,Ex,Iy,nonoverlap,std::plus<double>(),
-				[](double x, double y){ return std::pow(x-y,2); })));
+	return exp(-gamma*dense_sqdist(Ix,Ex,Iy,Ey));
+}
+double RBFKernel::k_function(const SparseVectorView& x, const SparseVectorView& y) const{
+	return exp(-getGamma()*squaredDistance(x,y));
+}
+double RBFKernel::k_function(const SparseRowF& x, const SparseVectorView& y) const{
+	return exp(-getGamma()*squaredDistance(x,y));
+}
+double RBFKernel::k_function(double inner, double xsquare, double ysquare) const{
+	// |x-y|^2 = |x|^2 + |y|^2 - 2<x,y>, clipped to avoid negative values due to rounding
+	double sqdist = xsquare+ysquare-2*inner;
+	return exp(-getGamma()*(sqdist > 0 ? sqdist : 0.0));
+}
+void RBFKernel::k_function(double *inner, const double *ysquares, double xsquare, size_t n) const{
+	for(size_t i=0;i<n;++i){
+		double sqdist = xsquare+ysquares[i]-2*inner[i];
+		inner[i]=-getGamma()*(sqdist > 0 ? sqdist : 0.0);
 	}
-
-	// used if length of x and y differ
-	double nonoverlap=std::accumulate(Ix+disty,Ex,0.0,
-			[](double x, double y){ return x+y*y;});
-
-	// rbf function
-	return exp(-gamma*std::inner_product(Iy,Ey,Ix,nonoverlap,std::plus<double>(),
-			[](double x, double y){ return std::pow(x-y,2); }));
+	exponential(inner,n);
 }
+bool RBFKernel::isInnerProductBased() const{ return true; }
 bool RBFKernel::operator==(const RBFKernel &other) const{
 	return (getGamma()==other.getGamma());
 }
@@ -207,10 +273,23 @@ double SigmoidKernel::k_function(const SparseVector *x, const SparseVector *y) c
 	return tanh(getGamma()*InnerProduct(*x,*y)+getCoef());
 }
 double SigmoidKernel::k_function(const_iterator Ix, const_iterator Ex, const_iterator Iy, const_iterator Ey) const{
-	if(distance(Ix,Ex) <= distance(Iy,Ey))
-		return tanh(getGamma()*std::inner_product(Ix,Ex,Iy,0.0)+getCoef());
-	return tanh(getGamma()*std::inner_product(Iy,Ey,Ix,0.0)+getCoef());
+	return tanh(getGamma()*dense_inner(Ix,Ex,Iy,Ey)+getCoef());
+}
+double SigmoidKernel::k_function(const SparseVectorView& x, const SparseVectorView& y) const{
+	return tanh(getGamma()*InnerProduct(x,y)+getCoef());
+}
+double SigmoidKernel::k_function(const SparseRowF& x, const SparseVectorView& y) const{
+	return tanh(getGamma()*InnerProduct(x,y)+getCoef());
 }
+double SigmoidKernel::k_function(double inner, double xsquare, double ysquare) const{
+	return tanh(getGamma()*inner+getCoef());
+}
+void SigmoidKernel::k_function(double *inner, const double *ysquares, double xsquare, size_t n) const{
+	for(size_t i=0;i<n;++i)
+		inner[i]=getGamma()*inner[i]+getCoef();
+	hyperbolicTangent(inner,n);
+}
+bool SigmoidKernel::isInnerProductBased() const{ return true; }
 bool SigmoidKernel::operator==(const SigmoidKernel &other) const{
 	return (getGamma()==other.getGamma() && getCoef()==other.getCoef());
 }
@@ -240,6 +319,15 @@ double UserdefKernel::k_function(const_iterator Ix, const_iterator Ex, const_ite
 	assert(std::distance(Iy,Ey) > *Ix);
 	return *(Iy+*Ix);
 }
+double UserdefKernel::k_function(const SparseVectorView& x, const SparseVectorView& y) const{
+	assert(x.numNonzero()==1);
+	return y[x.value(0)];
+}
+double UserdefKernel::k_function(const SparseRowF& x, const SparseVectorView& y) const{
+	// indices stored as float are exact up to 2^24
+	assert(x.nnz==1);
+	return y[x.values[0]];
+}
 bool UserdefKernel::operator==(const UserdefKernel &other) const{
 	return true; // fixme
 }
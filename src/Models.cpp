@@ -58,56 +58,42 @@ std::streamsize PRECISION = 16;
  * 	nr_sv <unsigned <unsigned> ...
  */
 SVMModel::Classes readClasses(std::istream &is){
-	string line, keyword;
-	std::istringstream iss;
+	TextScanner scanner(is);
+	string keyword;
 
-	unsigned nr_class, total_sv;
+	unsigned nr_class=0, total_sv=0;
 
 	// read nr_class
-	getline(is,line);
-	iss.str(line);
-	iss >> keyword;
+	scanner.word(keyword);
 	if(keyword.compare(NRCLASS_STR)!=0)
-		exit_with_err(string("Invalid model file, expecting nr_class but got ") + line);
-	iss >> nr_class;
-	iss.clear();
+		exit_with_err(string("Invalid model file, expecting nr_class but got ") + keyword);
+	scanner.number(nr_class);
+	scanner.next_line();
 
 	// read total_sv
-	getline(is,line);
-	iss.str(line);
-	iss >> keyword;
+	scanner.word(keyword);
 	if(keyword.compare(TOTALSV_STR)!=0)
-		exit_with_err(string("Invalid model file, expecting total_sv but got ") + line);
-	iss >> total_sv;
-	iss.clear();
+		exit_with_err(string("Invalid model file, expecting total_sv but got ") + keyword);
+	scanner.number(total_sv);
+	scanner.next_line();
 
 	SVMModel::Classes classes(nr_class,make_pair(string(""),0));
 
 	// read labels
-	getline(is,line);
-	iss.str(line);
-	iss >> keyword;
+	scanner.word(keyword);
 	if(keyword.compare(LABEL_STR)!=0)
-		exit_with_err(string("Invalid model file, expecting label but got ") + line);
-	for(unsigned i=0;i<nr_class;++i){
-		string label;
-		iss >> label;
-		classes.at(i).first=label;
-	}
-	iss.clear();
+		exit_with_err(string("Invalid model file, expecting label but got ") + keyword);
+	for(unsigned i=0;i<nr_class;++i)
+		scanner.word(classes.at(i).first);
+	scanner.next_line();
 
 	// read nr_sv
-	getline(is,line);
-	iss.str(line);
-	iss >> keyword;
+	scanner.word(keyword);
 	if(keyword.compare(NRSV_STR)!=0)
-		exit_with_err(string("Invalid model file, expecting nr_sv but got ") + line);
-	unsigned nr_sv;
-	for(unsigned i=0;i<nr_class;++i){
-		iss >> nr_sv;
-		classes.at(i).second=nr_sv;
-	}
-	iss.clear();
+		exit_with_err(string("Invalid model file, expecting nr_sv but got ") + keyword);
+	for(unsigned i=0;i<nr_class;++i)
+		scanner.number(classes.at(i).second);
+	scanner.next_line();
 
 	// sanity check
 	unsigned SVinclasses=0;
@@ -126,18 +112,17 @@ SVMModel::Classes readClasses(std::istream &is){
  * constants <double 1> <double 2> ... <double k*(k-1)/2>
  */
 std::vector<double> readConstants(std::istream &is, unsigned numclasses){
-	string line, keyword;
-	getline(is,line);
-	std::istringstream iss;
-	iss.str(line);
-	iss >> keyword;
+	TextScanner scanner(is);
+	string keyword;
+	scanner.word(keyword);
 	if(keyword.compare(CONSTANTS_STR)!=0)
-		exit_with_err(string("Invalid model file: expecting constants but recieved: ") + line);
+		exit_with_err(string("Invalid model file: expecting constants but recieved: ") + keyword);
 
 	unsigned numconstants = numclasses*(numclasses-1)/2;
 	std::vector<double> constants(numconstants,0);
 	for(unsigned i=0;i<numconstants;++i)
-		iss >> constants[i];
+		scanner.number(constants[i]);
+	scanner.next_line();
 	return std::move(constants);
 }
 
@@ -158,23 +143,49 @@ void Prediction::setLabel(const Label &label){ this->label=label; }
 void Prediction::setScore(Score score, unsigned idx){ scores.at(idx)=score; }
 Prediction::Score Prediction::getScore(unsigned idx) const{ return scores.at(idx); }
 Prediction::Score &Prediction::operator[](unsigned idx){ return scores.at(idx); }
+void Prediction::resize(unsigned numdecisions){ scores.resize(numdecisions); }
+
+PredictionContext::PredictionContext(const Model& model){
+	model.reserve(*this);
+}
 
 Model::Model(){}
 Model::Model(const Model &orig){}
 Prediction Model::predict(const struct svm_node *x) const{
-	SparseVector sv(x);
-	return predict(sv);
+	return predict(SparseVectorView(x));
 }
 std::vector<double> Model::decision_value(const struct svm_node *x) const{
-	SparseVector sv(x);
-	return decision_value(sv);
+	return decision_value(SparseVectorView(x));
+}
+Prediction Model::predict(const SparseVectorView &x) const{
+	return predict(SparseVector(x));
 }
+std::vector<double> Model::decision_value(const SparseVectorView &x) const{
+	return decision_value(SparseVector(x));
+}
+const Prediction& Model::predict(PredictionContext& ctx, const SparseVectorView &x) const{
+	ctx.prediction=predict(x);
+	return ctx.prediction;
+}
+const std::vector<double>& Model::decision_value(PredictionContext& ctx, const SparseVectorView &x) const{
+	ctx.decision_values=decision_value(x);
+	return ctx.decision_values;
+}
+void Model::reserve(PredictionContext& ctx) const{}
 
 
 BinaryModel::BinaryModel():Model(){}
 BinaryModel::BinaryModel(const BinaryModel& orig):Model(orig){}
 BinaryModel::~BinaryModel(){}
 
+std::vector<std::vector<double>> BinaryModel::decision_values(const std::vector<const SparseVector*>& batch) const{
+	std::vector<std::vector<double>> result;
+	result.reserve(batch.size());
+	for(auto x: batch)
+		result.emplace_back(decision_value(*x));
+	return result;
+}
+
 std::ostream &operator<<(std::ostream &os, const BinaryModel &model){
 	model.serialize(os);
 	return os;
@@ -194,9 +205,16 @@ std::unique_ptr<BinaryModel> BinaryModel::deserialize(std::istream& is){
 }
 
 unique_ptr<BinaryModel> BinaryModel::load(const string &fname){
-	std::ifstream file(fname.c_str(),std::ios::in);
-	assert(file && "Unable to open file.");
-	return BinaryModel::deserialize(file);
+	// models in binary format are decoded from the mapped file without an intermediate copy
+	MappedFile file(fname);
+	assert(file.is_open() && "Unable to open file.");
+	MemoryStreamBuffer buffer(file.data(),file.size());
+	std::istream is(&buffer);
+	return BinaryModel::deserialize(is);
+}
+
+void BinaryModel::serialize_binary(std::ostream& os) const{
+	serialize(os);
 }
 
 const std::vector<double> &SVMModel::getConstants() const{	return constants; }
@@ -218,10 +236,13 @@ SVMModel::SVMModel(const SVMModel &m)
 	for(const_iterator Im=m.begin(),Em=m.end();Im!=Em;++Im){
 		SVs.emplace_back(new SparseVector(*Im->get()));
 	}
+	squares=m.squares;
 }
 SVMModel::SVMModel(SVMModel&& m)
 :BinaryModel(std::move(m)),
  ens(m.ens),
+ SVs(std::move(m.SVs)),
+ squares(std::move(m.squares)),
  weights(std::move(m.weights)),
  classes(std::move(m.classes)),
  constants(std::move(m.constants)),
@@ -236,7 +257,9 @@ SVMModel::SVMModel(SV_container&& SVs, Weights&& weights, Classes&& classes, std
  classes(classes),
  constants(constants),
  kernel(kernel.release())
-{}
+{
+	computeSquares();
+}
 
 SVMModel::SVMModel(SV_container&& SVs, Weights&& weights, Classes&& classes, std::vector<double>&& constants, const SVMEnsemble *ens)
 :BinaryModel(),
@@ -252,6 +275,14 @@ SVMModel::SVMModel(SV_container&& SVs, Weights&& weights, Classes&& classes, std
 	// or when destroying a standalone SVMModel
 	// adding an SVMModel to 2 ensembles is impossible, e.g. kernel is const in SVMModel.
 	kernel = const_cast<Kernel*>(ens->getKernel());
+	computeSquares();
+}
+
+void SVMModel::computeSquares(){
+	squares.clear();
+	squares.reserve(SVs.size());
+	for(const_iterator I=begin(),E=end();I!=E;++I)
+		squares.push_back(squaredNorm(**I));
 }
 
 size_t SVMModel::size() const{	return SVs.size(); }
@@ -288,6 +319,9 @@ void SVMModel::updateLabel(const std::string &current, const std::string &replac
 }
 
 Prediction SVMModel::predict(const SparseVector &v) const{
+	return predict(SparseVectorView(v));
+}
+Prediction SVMModel::predict(const SparseVectorView &v) const{
 	std::vector<double> value = decision_value(v);
 	if(value[0] > 0) return Prediction(getLabel(0),value);
 	else return Prediction(getLabel(1),std::move(value));
@@ -300,17 +334,44 @@ Prediction SVMModel::predict(const std::vector<double> &v) const{
 }
 
 std::vector<double> SVMModel::decision_value(const SparseVector &v) const{
-	unsigned numSV=size(), i=0;
-	std::vector<double> kernelevals(numSV,0);
-
-	double value=0;
-	for(SVMModel::const_iterator I=begin(),E=end();I!=E;++I,++i){
-		value=kernel->k_function(I->get(),&v);
-		kernelevals[i]=value;
-	}
+	return decision_value(SparseVectorView(v));
+}
+std::vector<double> SVMModel::decision_value(const SparseVectorView &v) const{
+	std::vector<double> kernelevals;
+	kernel_evaluations(v,kernelevals);
 
 	std::vector<double> decval(1,predict_by_cache(kernelevals));
-	return std::move(decval);
+	return decval;
+}
+const Prediction& SVMModel::predict(PredictionContext& ctx, const SparseVectorView &v) const{
+	double value=decision_value(ctx,v)[0];
+	ctx.prediction.resize(1);
+	ctx.prediction[0]=value;
+	ctx.prediction.setLabel(classes.at(value > 0 ? 0 : 1).first);
+	return ctx.prediction;
+}
+const std::vector<double>& SVMModel::decision_value(PredictionContext& ctx, const SparseVectorView &v) const{
+	kernel_evaluations(v,ctx.cache);
+	ctx.decision_values.assign(1,predict_by_cache(ctx.cache));
+	return ctx.decision_values;
+}
+void SVMModel::reserve(PredictionContext& ctx) const{
+	ctx.cache.reserve(size());
+	ctx.decision_values.reserve(1);
+	ctx.prediction.resize(1);
+}
+void SVMModel::kernel_evaluations(const SparseVectorView &v, std::vector<double> &kernelevals) const{
+	unsigned i=0;
+	kernelevals.resize(size());
+
+	if(kernel->isInnerProductBased()){
+		double vsquare=squaredNorm(v);
+		for(SVMModel::const_iterator I=begin(),E=end();I!=E;++I,++i)
+			kernelevals[i]=kernel->k_function(InnerProduct(SparseVectorView(**I),v),squares[i],vsquare);
+	}else{
+		for(SVMModel::const_iterator I=begin(),E=end();I!=E;++I,++i)
+			kernelevals[i]=kernel->k_function(SparseVectorView(**I),v);
+	}
 }
 // fixme: inefficient implementation
 std::vector<double> SVMModel::decision_value(const std::vector<double> &v) const{
@@ -333,15 +394,9 @@ double SVMModel::predict_by_cache(const std::vector<double> &kernelevals) const{
 
 double SVMModel::svm_predict_values(const std::vector<double> &kernelevals) const{
 	unsigned i;
-	unsigned nr_class = getNumClasses();
-
-	std::vector<unsigned> start(nr_class,0);
-	for(i=1;i<nr_class;++i)
-		start[i]=start[i-1]+getNumSV(i-1);
-
-	std::vector<int> vote(nr_class,0);
+	assert(getNumClasses()==2 && "Only binary models are supported!");
 
-	// we deal with binary svm, so no need for loops
+	// we deal with binary svm, so no need for loops or a vote vector
 	// commented out in case we want to extend to multiclass later
 	unsigned p=0, j=1;
 	i=0;
@@ -349,8 +404,8 @@ double SVMModel::svm_predict_values(const std::vector<double> &kernelevals) cons
 //		for(unsigned j=i+1;j<nr_class;j++)
 //		{
 			double sum = 0;
-			unsigned si = start[i];
-			unsigned sj = start[j];
+			unsigned si = 0;
+			unsigned sj = getNumSV(i);
 			unsigned ci = getNumSV(i);
 			unsigned cj = getNumSV(j);
 
@@ -536,21 +591,17 @@ unique_ptr<SVMModel> SVMModel::read(std::istream &is, SVMEnsemble *ens){
 
 	unique_ptr<SVMModel> model;
 
-	string line, keyword;
-	if(ens){ // fixme: clean this up
-		getline(is,line); // read SVMModel line
-		line.clear();
-	}
+	string keyword;
+	TextScanner scanner(is);
+	if(ens) // fixme: clean this up
+		scanner.next_line(); // read SVMModel line
 
 	// check first line to see if we're dealing with a libsvm model or a true SVMModel
-	getline(is,line);
-
-	std::istringstream iss;
-	iss.str(line);
-	iss >> keyword;
+	scanner.word(keyword);
 	if(keyword.compare(INENSEMBLE_STR)==0){
-		unsigned inensemble;
-		iss >> inensemble;
+		unsigned inensemble=0;
+		scanner.number(inensemble);
+		scanner.next_line();
 
 		// sanity check: if the model belongs to an ensemble, ens cannot be nullptr
 		assert((inensemble==1)==(ens!=nullptr));
@@ -577,37 +628,34 @@ unique_ptr<SVMModel> SVMModel::read(std::istream &is, SVMEnsemble *ens){
 		SVMModel::SV_container SVs;
 		SVs.reserve(numSV);
 
-		getline(is,line);
-		if(line.compare(SV_STR)!=0)
-			exit_with_err(string("Invalid model file: expecting SV but got ") + line);
+		scanner.word(keyword);
+		if(keyword.compare(SV_STR)!=0)
+			exit_with_err(string("Invalid model file: expecting SV but got ") + keyword);
+		scanner.next_line();
 
 		// fill weights and SVs by reading lines of the form (k classes):
 		//	<weight 1> ... <weight k-1> <SV> (standalone model)
 		// or
 		//	<weight> ... <weight k-1> <SVidx> (model belonging to ensemble)
 		for(unsigned i=0;i<numSV;++i){
-			if(!is.good())
+			if(scanner.eof())
 				exit_with_err("Premature end of file while reading model!");
 
-			iss.clear();
-			getline(is,line);
-			iss.str(line);
-
-			double weight;
 			for(unsigned j=0;j<k-1;++j){
-				iss >> weight;
-				weights.at(i+j*numSV)=weight;
+				if(!scanner.number(weights[i+j*numSV]))
+					exit_with_err("Invalid model file: expecting a weight.");
 			}
 
 			if(inensemble==1){
 				// model is part of ensemble, read the SV index
 				unsigned svidx;
-				iss >> svidx;
+				if(!scanner.number(svidx))
+					exit_with_err("Invalid model file: expecting an SV index.");
+				scanner.next_line();
 				SVs.emplace_back(ens->getSV(svidx));
 			}else{
 				// model is standalone, read the SV
-				unique_ptr<SparseVector> SVptr =SparseVector::read(iss);
-				SVs.emplace_back(std::make_shared<SparseVector>(*SVptr.release()));
+				SVs.emplace_back(SparseVector::read(scanner).release());
 			}
 		}
 
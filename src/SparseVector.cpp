@@ -31,6 +31,13 @@
 #include <sstream>
 #include <iostream>
 #include <algorithm>
+#include <cstring>
+#include <cstdint>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define ENSEMBLE_X86_DISPATCH
+#include <immintrin.h>
+#endif
 
 using std::string;
 
@@ -46,6 +53,426 @@ typedef std::deque<std::pair<int,double> > SVDeque;
 
 /*************************************************************************************************/
 
+// portable fallbacks, multiple accumulators to break dependency chains
+double dot_scalar(const double *x, const double *y, size_t n){
+	double s0=0.0, s1=0.0, s2=0.0, s3=0.0;
+	size_t i=0;
+	for(;i+4<=n;i+=4){
+		s0+=x[i]*y[i];
+		s1+=x[i+1]*y[i+1];
+		s2+=x[i+2]*y[i+2];
+		s3+=x[i+3]*y[i+3];
+	}
+	for(;i<n;++i)
+		s0+=x[i]*y[i];
+	return (s0+s1)+(s2+s3);
+}
+double dotf_scalar(const float *x, const double *y, size_t n){
+	double s0=0.0, s1=0.0, s2=0.0, s3=0.0;
+	size_t i=0;
+	for(;i+4<=n;i+=4){
+		s0+=x[i]*y[i];
+		s1+=x[i+1]*y[i+1];
+		s2+=x[i+2]*y[i+2];
+		s3+=x[i+3]*y[i+3];
+	}
+	for(;i<n;++i)
+		s0+=x[i]*y[i];
+	return (s0+s1)+(s2+s3);
+}
+double dot8_scalar(const int8_t *x, const double *y, size_t n){
+	double s0=0.0, s1=0.0, s2=0.0, s3=0.0;
+	size_t i=0;
+	for(;i+4<=n;i+=4){
+		s0+=x[i]*y[i];
+		s1+=x[i+1]*y[i+1];
+		s2+=x[i+2]*y[i+2];
+		s3+=x[i+3]*y[i+3];
+	}
+	for(;i<n;++i)
+		s0+=x[i]*y[i];
+	return (s0+s1)+(s2+s3);
+}
+double sqdist_scalar(const double *x, const double *y, size_t n){
+	double s0=0.0, s1=0.0, s2=0.0, s3=0.0;
+	size_t i=0;
+	for(;i+4<=n;i+=4){
+		double d0=x[i]-y[i], d1=x[i+1]-y[i+1], d2=x[i+2]-y[i+2], d3=x[i+3]-y[i+3];
+		s0+=d0*d0;
+		s1+=d1*d1;
+		s2+=d2*d2;
+		s3+=d3*d3;
+	}
+	for(;i<n;++i){
+		double d=x[i]-y[i];
+		s0+=d*d;
+	}
+	return (s0+s1)+(s2+s3);
+}
+
+// exp(x) = 2^k exp(r) with r = x - k ln(2) and |r| <= ln(2)/2, where exp(r) is evaluated
+// by its Taylor polynomial: degree 13 is accurate to about 1 ulp, degree 7 has a relative
+// error below 1e-8. Results are flushed to zero below EXP_MIN and infinite above EXP_MAX.
+// The scale 2^k is applied as 2*2^(k-1), so that k=1024 is representable.
+const double EXP_MIN=-708.0;
+const double EXP_MAX=709.782712893384;	// log(DBL_MAX)
+const double LOG2E=1.4426950408889634;
+const double LN2_HI=6.93147180369123816490e-01;	// trailing zero bits, so k*LN2_HI is exact
+const double LN2_LO=1.90821492927058770002e-10;
+const double EXP_SHIFTER=6755399441055744.0;	// 1.5*2^52: adding it rounds to an integer held in the low bits
+const double INV_FACTORIALS[14]={1.0,1.0,1.0/2,1.0/6,1.0/24,1.0/120,1.0/720,1.0/5040,1.0/40320,
+		1.0/362880,1.0/3628800,1.0/39916800,1.0/479001600,1.0/6227020800.0};
+const unsigned EXP_DEGREE=13;
+const unsigned EXP_FAST_DEGREE=7;
+
+// used by exp and tanh, see setFastTranscendentals()
+bool fastTranscendentals=false;
+
+template <unsigned DEGREE>
+double exp_poly(double x){
+	// NaN is detected by its bits, x!=x may be folded away under -ffast-math
+	uint64_t xbits;
+	std::memcpy(&xbits,&x,sizeof(x));
+	if((xbits & 0x7FFFFFFFFFFFFFFFull) > 0x7FF0000000000000ull) return x;
+	if(x<EXP_MIN) return 0.0;
+	if(x>EXP_MAX) return HUGE_VAL;
+	double kd=x*LOG2E+EXP_SHIFTER;
+	double k=kd-EXP_SHIFTER;
+	double r=(x-k*LN2_HI)-k*LN2_LO;
+	double p=INV_FACTORIALS[DEGREE];
+	for(unsigned d=DEGREE;d-->0;)
+		p=p*r+INV_FACTORIALS[d];
+	uint64_t bits=static_cast<uint64_t>(static_cast<int64_t>(k)+1022) << 52;
+	double scale;
+	std::memcpy(&scale,&bits,sizeof(scale));
+	return 2.0*(p*scale);
+}
+void exp_scalar(double *x, size_t n, bool fast){
+	if(fast){
+		for(size_t i=0;i<n;++i)
+			x[i]=exp_poly<EXP_FAST_DEGREE>(x[i]);
+	}else{
+		for(size_t i=0;i<n;++i)
+			x[i]=exp(x[i]);
+	}
+}
+
+#ifdef ENSEMBLE_X86_DISPATCH
+
+__attribute__((target("sse2")))
+double hsum_sse2(__m128d v){
+	return _mm_cvtsd_f64(_mm_add_sd(v,_mm_unpackhi_pd(v,v)));
+}
+
+__attribute__((target("sse2")))
+double dot_sse2(const double *x, const double *y, size_t n){
+	__m128d acc0=_mm_setzero_pd(), acc1=_mm_setzero_pd();
+	size_t i=0;
+	for(;i+4<=n;i+=4){
+		acc0=_mm_add_pd(acc0,_mm_mul_pd(_mm_loadu_pd(x+i),_mm_loadu_pd(y+i)));
+		acc1=_mm_add_pd(acc1,_mm_mul_pd(_mm_loadu_pd(x+i+2),_mm_loadu_pd(y+i+2)));
+	}
+	double result=hsum_sse2(_mm_add_pd(acc0,acc1));
+	for(;i<n;++i)
+		result+=x[i]*y[i];
+	return result;
+}
+// single precision x is widened to double before multiplying
+__attribute__((target("sse2")))
+double dotf_sse2(const float *x, const double *y, size_t n){
+	__m128d acc0=_mm_setzero_pd(), acc1=_mm_setzero_pd();
+	size_t i=0;
+	for(;i+4<=n;i+=4){
+		__m128 xf=_mm_loadu_ps(x+i);
+		acc0=_mm_add_pd(acc0,_mm_mul_pd(_mm_cvtps_pd(xf),_mm_loadu_pd(y+i)));
+		acc1=_mm_add_pd(acc1,_mm_mul_pd(_mm_cvtps_pd(_mm_movehl_ps(xf,xf)),_mm_loadu_pd(y+i+2)));
+	}
+	double result=hsum_sse2(_mm_add_pd(acc0,acc1));
+	for(;i<n;++i)
+		result+=x[i]*y[i];
+	return result;
+}
+__attribute__((target("sse2")))
+double sqdist_sse2(const double *x, const double *y, size_t n){
+	__m128d acc0=_mm_setzero_pd(), acc1=_mm_setzero_pd();
+	size_t i=0;
+	for(;i+4<=n;i+=4){
+		__m128d d0=_mm_sub_pd(_mm_loadu_pd(x+i),_mm_loadu_pd(y+i));
+		__m128d d1=_mm_sub_pd(_mm_loadu_pd(x+i+2),_mm_loadu_pd(y+i+2));
+		acc0=_mm_add_pd(acc0,_mm_mul_pd(d0,d0));
+		acc1=_mm_add_pd(acc1,_mm_mul_pd(d1,d1));
+	}
+	double result=hsum_sse2(_mm_add_pd(acc0,acc1));
+	for(;i<n;++i){
+		double d=x[i]-y[i];
+		result+=d*d;
+	}
+	return result;
+}
+
+__attribute__((target("avx2,fma")))
+double hsum_avx2(__m256d v){
+	__m128d sum=_mm_add_pd(_mm256_castpd256_pd128(v),_mm256_extractf128_pd(v,1));
+	return _mm_cvtsd_f64(_mm_add_sd(sum,_mm_unpackhi_pd(sum,sum)));
+}
+
+__attribute__((target("avx2,fma")))
+double dot_avx2(const double *x, const double *y, size_t n){
+	__m256d acc0=_mm256_setzero_pd(), acc1=_mm256_setzero_pd();
+	size_t i=0;
+	for(;i+8<=n;i+=8){
+		acc0=_mm256_fmadd_pd(_mm256_loadu_pd(x+i),_mm256_loadu_pd(y+i),acc0);
+		acc1=_mm256_fmadd_pd(_mm256_loadu_pd(x+i+4),_mm256_loadu_pd(y+i+4),acc1);
+	}
+	if(i+4<=n){
+		acc0=_mm256_fmadd_pd(_mm256_loadu_pd(x+i),_mm256_loadu_pd(y+i),acc0);
+		i+=4;
+	}
+	double result=hsum_avx2(_mm256_add_pd(acc0,acc1));
+	for(;i<n;++i)
+		result+=x[i]*y[i];
+	return result;
+}
+__attribute__((target("avx2,fma")))
+double dotf_avx2(const float *x, const double *y, size_t n){
+	__m256d acc0=_mm256_setzero_pd(), acc1=_mm256_setzero_pd();
+	size_t i=0;
+	for(;i+8<=n;i+=8){
+		__m256 xf=_mm256_loadu_ps(x+i);
+		acc0=_mm256_fmadd_pd(_mm256_cvtps_pd(_mm256_castps256_ps128(xf)),_mm256_loadu_pd(y+i),acc0);
+		acc1=_mm256_fmadd_pd(_mm256_cvtps_pd(_mm256_extractf128_ps(xf,1)),_mm256_loadu_pd(y+i+4),acc1);
+	}
+	if(i+4<=n){
+		acc0=_mm256_fmadd_pd(_mm256_cvtps_pd(_mm_loadu_ps(x+i)),_mm256_loadu_pd(y+i),acc0);
+		i+=4;
+	}
+	double result=hsum_avx2(_mm256_add_pd(acc0,acc1));
+	for(;i<n;++i)
+		result+=x[i]*y[i];
+	return result;
+}
+// int8 x is sign extended to 32 bits and converted to double, 8 values per load
+__attribute__((target("avx2,fma")))
+double dot8_avx2(const int8_t *x, const double *y, size_t n){
+	__m256d acc0=_mm256_setzero_pd(), acc1=_mm256_setzero_pd();
+	size_t i=0;
+	for(;i+8<=n;i+=8){
+		__m256i xi=_mm256_cvtepi8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(x+i)));
+		acc0=_mm256_fmadd_pd(_mm256_cvtepi32_pd(_mm256_castsi256_si128(xi)),_mm256_loadu_pd(y+i),acc0);
+		acc1=_mm256_fmadd_pd(_mm256_cvtepi32_pd(_mm256_extracti128_si256(xi,1)),_mm256_loadu_pd(y+i+4),acc1);
+	}
+	double result=hsum_avx2(_mm256_add_pd(acc0,acc1));
+	for(;i<n;++i)
+		result+=x[i]*y[i];
+	return result;
+}
+__attribute__((target("avx2,fma")))
+double sqdist_avx2(const double *x, const double *y, size_t n){
+	__m256d acc0=_mm256_setzero_pd(), acc1=_mm256_setzero_pd();
+	size_t i=0;
+	for(;i+8<=n;i+=8){
+		__m256d d0=_mm256_sub_pd(_mm256_loadu_pd(x+i),_mm256_loadu_pd(y+i));
+		__m256d d1=_mm256_sub_pd(_mm256_loadu_pd(x+i+4),_mm256_loadu_pd(y+i+4));
+		acc0=_mm256_fmadd_pd(d0,d0,acc0);
+		acc1=_mm256_fmadd_pd(d1,d1,acc1);
+	}
+	if(i+4<=n){
+		__m256d d=_mm256_sub_pd(_mm256_loadu_pd(x+i),_mm256_loadu_pd(y+i));
+		acc0=_mm256_fmadd_pd(d,d,acc0);
+		i+=4;
+	}
+	double result=hsum_avx2(_mm256_add_pd(acc0,acc1));
+	for(;i<n;++i){
+		double d=x[i]-y[i];
+		result+=d*d;
+	}
+	return result;
+}
+
+// GCC 12 reports the _mm512_undefined_pd() source operand of unmasked AVX-512 intrinsics as
+// uninitialized, so the AVX-512 kernels use zero-masked forms with all lanes enabled instead
+const __mmask8 ALL_LANES = 0xFF;
+
+__attribute__((target("avx512f")))
+double hsum_avx512(__m512d v){
+	__m256d sum=_mm256_add_pd(_mm512_maskz_extractf64x4_pd(0xF,v,0),_mm512_maskz_extractf64x4_pd(0xF,v,1));
+	__m128d half=_mm_add_pd(_mm256_castpd256_pd128(sum),_mm256_extractf128_pd(sum,1));
+	return _mm_cvtsd_f64(_mm_add_sd(half,_mm_unpackhi_pd(half,half)));
+}
+
+__attribute__((target("avx512f")))
+double dot_avx512(const double *x, const double *y, size_t n){
+	__m512d acc0=_mm512_setzero_pd(), acc1=_mm512_setzero_pd();
+	size_t i=0;
+	for(;i+16<=n;i+=16){
+		acc0=_mm512_fmadd_pd(_mm512_loadu_pd(x+i),_mm512_loadu_pd(y+i),acc0);
+		acc1=_mm512_fmadd_pd(_mm512_loadu_pd(x+i+8),_mm512_loadu_pd(y+i+8),acc1);
+	}
+	for(;i<n;i+=8){
+		// masked loads handle the remainder
+		__mmask8 mask = n-i >= 8 ? 0xFF : static_cast<__mmask8>((1u << (n-i))-1);
+		acc0=_mm512_fmadd_pd(_mm512_maskz_loadu_pd(mask,x+i),_mm512_maskz_loadu_pd(mask,y+i),acc0);
+	}
+	return hsum_avx512(_mm512_add_pd(acc0,acc1));
+}
+__attribute__((target("avx512f")))
+double dotf_avx512(const float *x, const double *y, size_t n){
+	__m512d acc0=_mm512_setzero_pd(), acc1=_mm512_setzero_pd();
+	size_t i=0;
+	for(;i+16<=n;i+=16){
+		acc0=_mm512_fmadd_pd(_mm512_maskz_cvtps_pd(ALL_LANES,_mm256_loadu_ps(x+i)),_mm512_loadu_pd(y+i),acc0);
+		acc1=_mm512_fmadd_pd(_mm512_maskz_cvtps_pd(ALL_LANES,_mm256_loadu_ps(x+i+8)),_mm512_loadu_pd(y+i+8),acc1);
+	}
+	for(;i<n;i+=8){
+		__mmask8 mask = n-i >= 8 ? 0xFF : static_cast<__mmask8>((1u << (n-i))-1);
+		float tail[8]={0};	// the remaining floats, zero padded
+		std::copy(x+i,x+std::min(n,i+8),tail);
+		__m512d xd=_mm512_maskz_cvtps_pd(ALL_LANES,_mm256_loadu_ps(tail));
+		acc0=_mm512_fmadd_pd(xd,_mm512_maskz_loadu_pd(mask,y+i),acc0);
+	}
+	return hsum_avx512(_mm512_add_pd(acc0,acc1));
+}
+__attribute__((target("avx512f")))
+double dot8_avx512(const int8_t *x, const double *y, size_t n){
+	__m512d acc0=_mm512_setzero_pd(), acc1=_mm512_setzero_pd();
+	size_t i=0;
+	for(;i+16<=n;i+=16){
+		__m128i xi=_mm_loadu_si128(reinterpret_cast<const __m128i*>(x+i));
+		acc0=_mm512_fmadd_pd(_mm512_maskz_cvtepi32_pd(ALL_LANES,_mm256_cvtepi8_epi32(xi)),_mm512_loadu_pd(y+i),acc0);
+		acc1=_mm512_fmadd_pd(_mm512_maskz_cvtepi32_pd(ALL_LANES,_mm256_cvtepi8_epi32(_mm_srli_si128(xi,8))),_mm512_loadu_pd(y+i+8),acc1);
+	}
+	for(;i<n;i+=8){
+		__mmask8 mask = n-i >= 8 ? 0xFF : static_cast<__mmask8>((1u << (n-i))-1);
+		int8_t tail[8]={0};	// the remaining levels, zero padded
+		std::copy(x+i,x+std::min(n,i+8),tail);
+		__m512d xd=_mm512_maskz_cvtepi32_pd(ALL_LANES,_mm256_cvtepi8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(tail))));
+		acc0=_mm512_fmadd_pd(xd,_mm512_maskz_loadu_pd(mask,y+i),acc0);
+	}
+	return hsum_avx512(_mm512_add_pd(acc0,acc1));
+}
+__attribute__((target("avx512f")))
+double sqdist_avx512(const double *x, const double *y, size_t n){
+	__m512d acc0=_mm512_setzero_pd(), acc1=_mm512_setzero_pd();
+	size_t i=0;
+	for(;i+16<=n;i+=16){
+		__m512d d0=_mm512_sub_pd(_mm512_loadu_pd(x+i),_mm512_loadu_pd(y+i));
+		__m512d d1=_mm512_sub_pd(_mm512_loadu_pd(x+i+8),_mm512_loadu_pd(y+i+8));
+		acc0=_mm512_fmadd_pd(d0,d0,acc0);
+		acc1=_mm512_fmadd_pd(d1,d1,acc1);
+	}
+	for(;i<n;i+=8){
+		__mmask8 mask = n-i >= 8 ? 0xFF : static_cast<__mmask8>((1u << (n-i))-1);
+		__m512d d=_mm512_sub_pd(_mm512_maskz_loadu_pd(mask,x+i),_mm512_maskz_loadu_pd(mask,y+i));
+		acc0=_mm512_fmadd_pd(d,d,acc0);
+	}
+	return hsum_avx512(_mm512_add_pd(acc0,acc1));
+}
+
+template <unsigned DEGREE>
+__attribute__((target("avx2,fma")))
+void exp_avx2_impl(double *x, size_t n){
+	const __m256d lower=_mm256_set1_pd(EXP_MIN), upper=_mm256_set1_pd(EXP_MAX);
+	const __m256d log2e=_mm256_set1_pd(LOG2E), shifter=_mm256_set1_pd(EXP_SHIFTER);
+	const __m256d ln2hi=_mm256_set1_pd(LN2_HI), ln2lo=_mm256_set1_pd(LN2_LO);
+	const __m256d zero=_mm256_setzero_pd(), inf=_mm256_set1_pd(HUGE_VAL);
+	const __m256i bias=_mm256_set1_epi64x(1022), lanes=_mm256_setr_epi64x(0,1,2,3);
+	for(size_t i=0;i<n;i+=4){
+		// the remainder is masked rather than computed by exp_poly(), so that every element
+		// is rounded the same regardless of its position
+		__m256i mask=_mm256_cmpgt_epi64(_mm256_set1_epi64x(n-i),lanes);
+		__m256d v=_mm256_maskload_pd(x+i,mask);
+		__m256d c=_mm256_min_pd(_mm256_max_pd(v,lower),upper);
+		__m256d kd=_mm256_fmadd_pd(c,log2e,shifter);
+		__m256d k=_mm256_sub_pd(kd,shifter);
+		__m256d r=_mm256_fnmadd_pd(k,ln2lo,_mm256_fnmadd_pd(k,ln2hi,c));
+		__m256d p=_mm256_set1_pd(INV_FACTORIALS[DEGREE]);
+		for(unsigned d=DEGREE;d-->0;)
+			p=_mm256_fmadd_pd(p,r,_mm256_set1_pd(INV_FACTORIALS[d]));
+		__m256i bits=_mm256_slli_epi64(_mm256_add_epi64(_mm256_castpd_si256(kd),bias),52);
+		__m256d result=_mm256_add_pd(p,p);
+		result=_mm256_mul_pd(result,_mm256_castsi256_pd(bits));
+		result=_mm256_blendv_pd(result,zero,_mm256_cmp_pd(v,lower,_CMP_LT_OQ));
+		result=_mm256_blendv_pd(result,inf,_mm256_cmp_pd(v,upper,_CMP_GT_OQ));
+		result=_mm256_blendv_pd(result,v,_mm256_cmp_pd(v,v,_CMP_UNORD_Q));
+		_mm256_maskstore_pd(x+i,mask,result);
+	}
+}
+__attribute__((target("avx2,fma")))
+void exp_avx2(double *x, size_t n, bool fast){
+	if(fast) exp_avx2_impl<EXP_FAST_DEGREE>(x,n);
+	else exp_avx2_impl<EXP_DEGREE>(x,n);
+}
+
+template <unsigned DEGREE>
+__attribute__((target("avx512f")))
+void exp_avx512_impl(double *x, size_t n){
+	const __m512d lower=_mm512_set1_pd(EXP_MIN), upper=_mm512_set1_pd(EXP_MAX);
+	const __m512d log2e=_mm512_set1_pd(LOG2E), shifter=_mm512_set1_pd(EXP_SHIFTER);
+	const __m512d ln2hi=_mm512_set1_pd(LN2_HI), ln2lo=_mm512_set1_pd(LN2_LO);
+	const __m512d zero=_mm512_setzero_pd(), inf=_mm512_set1_pd(HUGE_VAL);
+	const __m512i bias=_mm512_set1_epi64(1022);
+	for(size_t i=0;i<n;i+=8){
+		__mmask8 mask = n-i >= 8 ? 0xFF : static_cast<__mmask8>((1u << (n-i))-1);
+		__m512d v=_mm512_maskz_loadu_pd(mask,x+i);
+		__m512d c=_mm512_maskz_min_pd(ALL_LANES,_mm512_maskz_max_pd(ALL_LANES,v,lower),upper);
+		__m512d kd=_mm512_fmadd_pd(c,log2e,shifter);
+		__m512d k=_mm512_sub_pd(kd,shifter);
+		__m512d r=_mm512_fnmadd_pd(k,ln2lo,_mm512_fnmadd_pd(k,ln2hi,c));
+		__m512d p=_mm512_set1_pd(INV_FACTORIALS[DEGREE]);
+		for(unsigned d=DEGREE;d-->0;)
+			p=_mm512_fmadd_pd(p,r,_mm512_set1_pd(INV_FACTORIALS[d]));
+		__m512i bits=_mm512_maskz_slli_epi64(ALL_LANES,_mm512_add_epi64(_mm512_castpd_si512(kd),bias),52);
+		__m512d result=_mm512_add_pd(p,p);
+		result=_mm512_mul_pd(result,_mm512_castsi512_pd(bits));
+		result=_mm512_mask_blend_pd(_mm512_cmp_pd_mask(v,lower,_CMP_LT_OQ),result,zero);
+		result=_mm512_mask_blend_pd(_mm512_cmp_pd_mask(v,upper,_CMP_GT_OQ),result,inf);
+		result=_mm512_mask_blend_pd(_mm512_cmp_pd_mask(v,v,_CMP_UNORD_Q),result,v);
+		_mm512_mask_storeu_pd(x+i,mask,result);
+	}
+}
+__attribute__((target("avx512f")))
+void exp_avx512(double *x, size_t n, bool fast){
+	if(fast) exp_avx512_impl<EXP_FAST_DEGREE>(x,n);
+	else exp_avx512_impl<EXP_DEGREE>(x,n);
+}
+
+#endif // ENSEMBLE_X86_DISPATCH
+
+/**
+ * Dense kernel implementations for a specific instruction set.
+ */
+struct DenseOps{
+	const char* isa;
+	double (*dot)(const double*, const double*, size_t);
+	double (*dotf)(const float*, const double*, size_t);
+	double (*dot8)(const int8_t*, const double*, size_t);
+	double (*sqdist)(const double*, const double*, size_t);
+	void (*exp)(double*, size_t, bool);
+};
+
+DenseOps select_dense_ops(){
+#ifdef ENSEMBLE_X86_DISPATCH
+	__builtin_cpu_init();
+	if(__builtin_cpu_supports("avx512f"))
+		return DenseOps{"avx512",&dot_avx512,&dotf_avx512,&dot8_avx512,&sqdist_avx512,&exp_avx512};
+	if(__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+		return DenseOps{"avx2",&dot_avx2,&dotf_avx2,&dot8_avx2,&sqdist_avx2,&exp_avx2};
+	if(__builtin_cpu_supports("sse2"))
+		return DenseOps{"sse2",&dot_sse2,&dotf_sse2,&dot8_scalar,&sqdist_sse2,&exp_scalar};
+#endif
+	return DenseOps{"scalar",&dot_scalar,&dotf_scalar,&dot8_scalar,&sqdist_scalar,&exp_scalar};
+}
+
+/**
+ * Returns the dense kernels for the current CPU, selected on first use.
+ */
+const DenseOps& dense_ops(){
+	static const DenseOps ops=select_dense_ops();
+	return ops;
+}
+
+/*************************************************************************************************/
+
 }
 
 /*************************************************************************************************/
@@ -77,6 +504,19 @@ SparseVector::SparseVector(const svm_node* x){
 		sparseSV.emplace_back(x[i].index,x[i].value);
 	}
 }
+template <typename T>
+SparseVector::SparseVector(const BasicSparseRow<T>& row):sparseSV(){
+	sparseSV.reserve(row.nnz);
+	for(size_t k=0;k<row.nnz;++k)
+		sparseSV.push_back(std::make_pair(row.indices[k],static_cast<double>(row.values[k])));
+}
+template SparseVector::SparseVector(const SparseRow& row);
+template SparseVector::SparseVector(const SparseRowF& row);
+SparseVector::SparseVector(const SparseVectorView& v):sparseSV(){
+	sparseSV.reserve(v.numNonzero());
+	for(size_t k=0,n=v.numNonzero();k<n;++k)
+		sparseSV.emplace_back(v.index(k),v.value(k));
+}
 SparseVector::size_type SparseVector::numNonzero() const{ return sparseSV.size(); }
 unsigned SparseVector::size() const{
 	if(sparseSV.empty()) return 0;
@@ -146,6 +586,25 @@ bool SparseVector::operator!=(const SparseVector& other) const{
 	return !operator==(other);
 }
 
+size_t SparseVector::hash() const{
+	// 64-bit FNV-1a over indices and value bit patterns
+	uint64_t h=14695981039346656037ULL;
+	auto mix=[&h](uint64_t word){
+		for(unsigned b=0;b<8;++b,word>>=8){
+			h^=word & 0xff;
+			h*=1099511628211ULL;
+		}
+	};
+	for(const_iterator I=begin(),E=end();I!=E;++I){
+		double value = I->second==0.0 ? 0.0 : I->second;	// -0.0 equals 0.0
+		uint64_t bits;
+		std::memcpy(&bits,&value,sizeof(bits));
+		mix(I->first);
+		mix(bits);
+	}
+	return static_cast<size_t>(h);
+}
+
 std::vector<double> SparseVector::dense() const{
 	if(numNonzero() == 0) return std::move(std::vector<double>(0));
 	std::vector<double> result(rbegin()->first,0.0);
@@ -159,11 +618,8 @@ void SparseVector::trim(size_t maxlen){
 	if(maxlen==0){
 		sparseSV.clear();
 	}else{
-		reverse_iterator I=rbegin();
-		while(I->first > maxlen){
-			sparseSV.erase(begin()+sparseSV.size()-1);
-			I=rbegin();
-		}
+		while(!sparseSV.empty() && sparseSV.back().first > maxlen)
+			sparseSV.pop_back();
 	}
 }
 
@@ -299,6 +755,121 @@ std::shared_ptr<SparseVector> linear_combination(const std::vector<std::shared_p
 
 /*************************************************************************************************/
 
+template <typename T>
+BasicSparseMatrix<T>::BasicSparseMatrix():offsets(1,0){}
+
+template <typename T>
+size_t BasicSparseMatrix<T>::append(const SparseVector& v){
+	for(SparseVector::const_iterator I=v.begin(),E=v.end();I!=E;++I){
+		indices.push_back(I->first);
+		values.push_back(static_cast<T>(I->second));
+	}
+	offsets.push_back(indices.size());
+	return rows()-1;
+}
+template <typename T>
+size_t BasicSparseMatrix<T>::append(const SparseVector::SparseSV& v){
+	for(SparseVector::SparseSV::const_iterator I=v.begin(),E=v.end();I!=E;++I){
+		indices.push_back(I->first);
+		values.push_back(static_cast<T>(I->second));
+	}
+	offsets.push_back(indices.size());
+	return rows()-1;
+}
+template <typename T>
+size_t BasicSparseMatrix<T>::rows() const{ return offsets.size()-1; }
+template <typename T>
+size_t BasicSparseMatrix<T>::numNonzero() const{ return indices.size(); }
+template <typename T>
+BasicSparseRow<T> BasicSparseMatrix<T>::row(size_t idx) const{
+	assert(idx < rows() && "Row index out of bounds!");
+	size_t start=offsets[idx];
+	return BasicSparseRow<T>{indices.data()+start, values.data()+start, offsets[idx+1]-start};
+}
+template <typename T>
+BasicSparseMatrix<T> BasicSparseMatrix<T>::transpose() const{
+	BasicSparseMatrix<T> result;
+	size_t numcols = indices.empty() ? 0 : *std::max_element(indices.begin(),indices.end())+1;
+
+	// counting sort on column indices
+	result.offsets.assign(numcols+1,0);
+	for(auto idx: indices)
+		++result.offsets[idx+1];
+	for(size_t j=1;j<=numcols;++j)
+		result.offsets[j]+=result.offsets[j-1];
+
+	result.indices.resize(indices.size());
+	result.values.resize(values.size());
+	std::vector<size_t> position(result.offsets.begin(),result.offsets.end()-1);
+	for(size_t i=0,n=rows();i<n;++i){
+		for(size_t k=offsets[i];k<offsets[i+1];++k){
+			size_t p=position[indices[k]]++;
+			result.indices[p]=i;
+			result.values[p]=values[k];
+		}
+	}
+	return result;
+}
+template <typename T>
+void BasicSparseMatrix<T>::reserve(size_t rows, size_t nnz){
+	offsets.reserve(rows+1);
+	indices.reserve(nnz);
+	values.reserve(nnz);
+}
+template <typename T>
+void BasicSparseMatrix<T>::clear(){
+	indices.clear();
+	values.clear();
+	offsets.assign(1,0);
+}
+
+template class BasicSparseMatrix<double>;
+template class BasicSparseMatrix<float>;
+template class BasicSparseMatrix<int8_t>;
+
+/*************************************************************************************************/
+
+SparseVectorView::SparseVectorView(const SparseVector& v)
+	:indexptr(nullptr),valueptr(nullptr),
+	 indexstride(sizeof(std::pair<unsigned,double>)),valuestride(sizeof(std::pair<unsigned,double>)),
+	 nnz(v.numNonzero())
+{
+	if(nnz){
+		indexptr=reinterpret_cast<const char*>(&v.begin()->first);
+		valueptr=reinterpret_cast<const char*>(&v.begin()->second);
+	}
+}
+SparseVectorView::SparseVectorView(const SparseRow& row)
+	:SparseVectorView(row.indices,row.values,row.nnz){}
+SparseVectorView::SparseVectorView(const unsigned *indices, const double *values, size_t nnz)
+	:indexptr(reinterpret_cast<const char*>(indices)),valueptr(reinterpret_cast<const char*>(values)),
+	 indexstride(sizeof(unsigned)),valuestride(sizeof(double)),nnz(nnz){}
+SparseVectorView::SparseVectorView(const svm_node *x)
+	:indexptr(reinterpret_cast<const char*>(&x->index)),valueptr(reinterpret_cast<const char*>(&x->value)),
+	 indexstride(sizeof(svm_node)),valuestride(sizeof(svm_node)),nnz(0)
+{
+	static_assert(sizeof(x->index)==sizeof(unsigned),"svm_node indices must be readable as unsigned");
+	while(x[nnz].index!=-1)
+		++nnz;
+}
+size_t SparseVectorView::lower_bound(unsigned idx) const{
+	size_t lo=0, hi=nnz;
+	while(lo<hi){
+		size_t mid=lo+(hi-lo)/2;
+		if(index(mid)<idx) lo=mid+1;
+		else hi=mid;
+	}
+	return lo;
+}
+double SparseVectorView::operator[](unsigned idx) const{
+	size_t k=lower_bound(idx);
+	if(k<nnz && index(k)==idx)
+		return value(k);
+	return 0.0;
+}
+
+/*************************************************************************************************/
+
 double InnerProduct(const SparseVector &x, const SparseVector &y){
 	double result=0.0;
 	SparseVector::const_iterator Ix=x.begin(),Iy=y.begin(),Ex=x.end(),Ey=y.end();
@@ -334,6 +905,75 @@ double InnerProduct(const vector<pair<unsigned,double> > &x, const SparseVector
 	return result;
 }
 
+namespace{
+
+// uniform access to the nonzeros of matrix rows and views
+template <typename T>
+size_t nonzeros(const BasicSparseRow<T>& x){ return x.nnz; }
+template <typename T>
+unsigned index_at(const BasicSparseRow<T>& x, size_t k){ return x.indices[k]; }
+template <typename T>
+double value_at(const BasicSparseRow<T>& x, size_t k){ return x.values[k]; }
+
+size_t nonzeros(const SparseVectorView& x){ return x.numNonzero(); }
+unsigned index_at(const SparseVectorView& x, size_t k){ return x.index(k); }
+double value_at(const SparseVectorView& x, size_t k){ return x.value(k); }
+
+template <typename X>
+double view_inner_product(const X &x, const SparseVectorView &y){
+	double result=0.0;
+	size_t kx=0, ky=0, nx=nonzeros(x), ny=y.numNonzero();
+	while(kx<nx && ky<ny){
+		unsigned ix=index_at(x,kx), iy=y.index(ky);
+		if(ix==iy){
+			result += value_at(x,kx)*y.value(ky);
+			++kx;
+			++ky;
+		}else if(ix < iy){
+			++kx;
+		}else{
+			++ky;
+		}
+	}
+	return result;
+}
+
+template <typename X>
+double view_squared_distance(const X &x, const SparseVectorView &y){
+	double dist=0.0;
+	size_t kx=0, ky=0, nx=nonzeros(x), ny=y.numNonzero();
+	while(kx<nx && ky<ny){
+		unsigned ix=index_at(x,kx), iy=y.index(ky);
+		if(ix==iy){
+			double d=value_at(x,kx)-y.value(ky);
+			dist+=d*d;
+			++kx;
+			++ky;
+		}else if(ix < iy){
+			dist+=value_at(x,kx)*value_at(x,kx);
+			++kx;
+		}else{
+			dist+=y.value(ky)*y.value(ky);
+			++ky;
+		}
+	}
+	for(;kx<nx;++kx) dist+=value_at(x,kx)*value_at(x,kx);
+	for(;ky<ny;++ky) dist+=y.value(ky)*y.value(ky);
+	return dist;
+}
+
+} // anonymous namespace
+
+double InnerProduct(const SparseVectorView &x, const SparseVectorView &y){
+	return view_inner_product(x,y);
+}
+double InnerProduct(const SparseRowF &x, const SparseVectorView &y){
+	return view_inner_product(x,y);
+}
+double InnerProduct(const SparseRow8 &x, const SparseVectorView &y){
+	return view_inner_product(x,y);
+}
+
 double InnerProduct(const vector<pair<unsigned,double> > &x, const vector<pair<unsigned,double> > &y){
 	double result=0.0;
 	vector<pair<unsigned,double> >::const_iterator Ix=x.begin(),Ex=x.end(),Iy=y.begin(),Ey=y.end();
@@ -371,50 +1011,31 @@ std::ostream &operator<<(std::ostream &os, const SparseVector &v){
 	return os;
 }
 
-// todo make more efficient
 unique_ptr<SparseVector> SparseVector::read(std::istream &iss, bool csv){
-	unique_ptr<SparseVector> sv(new SparseVector());
-
-	char junk;
+	TextScanner scanner(iss);
+	return read(scanner,csv);
+}
 
-	string line;
-	getline(iss,line);
-	if(csv)
-		std::replace(line.begin(),line.end(),',',' ');
+unique_ptr<SparseVector> SparseVector::read(TextScanner &scanner, bool csv){
+	unique_ptr<SparseVector> sv(new SparseVector());
 
-	std::istringstream linestr(line,std::istringstream::in);
+	// nonzeros are collected in a reused buffer, so the result is allocated exactly once
+	static thread_local SparseSV nonzeros;
+	nonzeros.clear();
 
-	int key;
+	char separator = csv ? ',' : ' ';
+	unsigned key;
 	double value;
-	SVDeque svdeque;
-
-	while(linestr.good()){
-		key=-1;
-		linestr >> key;
-
-		if(key<0)
-			break;
-
-		linestr.get(junk);
-
-		if(junk!=*":" && !linestr.eof()){
-			// invalid model file!
-			exit_with_err(string("Wrong format, expecting ':' but got '") + junk + "'.");
-		}
-
-		linestr >> value;
-
-		svdeque.push_back(std::make_pair(key,value));
-
-//		if(csv){ // if this is a csv-file, discard commas
-//			if(linestr.good())
-//				linestr.ignore(1,',');
-//		}
+	while(scanner.skip_blanks(separator) && scanner.number(key)){
+		if(!scanner.consume(':'))
+			exit_with_err(string("Wrong format, expecting ':' but got '") + static_cast<char>(scanner.peek()) + "'.");
+		if(!scanner.number(value))
+			exit_with_err("Wrong format, expecting a value after ':'.");
+		nonzeros.emplace_back(key,value);
 	}
+	scanner.next_line();
 
-	sv->sparseSV.reserve(svdeque.size());
-	std::copy(svdeque.begin(),svdeque.end(),std::back_inserter(sv->sparseSV));
-
+	sv->sparseSV.assign(nonzeros.begin(),nonzeros.end());
 	return sv;
 }
 
@@ -531,6 +1152,96 @@ double squaredNorm(const vector<pair<unsigned,double> > &v){
 			norm+=pow(I->second,2);
 	return norm;
 }
+double squaredNorm(const SparseRow &v){
+	return squaredNorm(v.values,v.nnz);
+}
+double squaredNorm(const SparseRowF &v){
+	double norm=0;
+	for(size_t k=0;k<v.nnz;++k)
+		norm+=static_cast<double>(v.values[k])*v.values[k];
+	return norm;
+}
+double squaredNorm(const SparseVectorView &v){
+	double norm=0;
+	for(size_t k=0,n=v.numNonzero();k<n;++k)
+		norm+=v.value(k)*v.value(k);
+	return norm;
+}
+
+double squaredDistance(const SparseVector &x, const SparseVector &y){
+	double dist=0;
+	SparseVector::const_iterator Ix=x.begin(),Ex=x.end(),Iy=y.begin(),Ey=y.end();
+	while(Ix!=Ex && Iy!=Ey){
+		if(Ix->first==Iy->first){
+			dist+=pow(Ix->second-Iy->second,2);
+			++Ix;
+			++Iy;
+		}else if(Ix->first < Iy->first){
+			dist+=pow(Ix->second,2);
+			++Ix;
+		}else{
+			dist+=pow(Iy->second,2);
+			++Iy;
+		}
+	}
+	for(;Ix!=Ex;++Ix) dist+=pow(Ix->second,2);
+	for(;Iy!=Ey;++Iy) dist+=pow(Iy->second,2);
+	return dist;
+}
+double squaredDistance(const SparseVectorView &x, const SparseVectorView &y){
+	return view_squared_distance(x,y);
+}
+double squaredDistance(const SparseRowF &x, const SparseVectorView &y){
+	return view_squared_distance(x,y);
+}
+
+double InnerProduct(const double *x, const double *y, size_t n){
+	return dense_ops().dot(x,y,n);
+}
+double InnerProduct(const float *x, const double *y, size_t n){
+	return dense_ops().dotf(x,y,n);
+}
+double InnerProduct(const int8_t *x, const double *y, size_t n){
+	return dense_ops().dot8(x,y,n);
+}
+double squaredDistance(const double *x, const double *y, size_t n){
+	return dense_ops().sqdist(x,y,n);
+}
+double squaredNorm(const double *x, size_t n){
+	return dense_ops().dot(x,x,n);
+}
+const char* denseKernelISA(){
+	return dense_ops().isa;
+}
+
+void exponential(double *x, size_t n){
+	dense_ops().exp(x,n,fastTranscendentals);
+}
+void hyperbolicTangent(double *x, size_t n){
+	// (1-e)/(1+e) loses relative accuracy for small |x|, so it is only used in fast mode
+	if(!fastTranscendentals){
+		for(size_t i=0;i<n;++i)
+			x[i]=tanh(x[i]);
+		return;
+	}
+
+	// tanh(x) = sign(x)*(1-e)/(1+e) with e=exp(-2|x|), in chunks to batch the exponentials
+	const size_t CHUNK=256;
+	double e[CHUNK];
+	for(size_t start=0;start<n;start+=CHUNK){
+		size_t m=std::min(CHUNK,n-start);
+		for(size_t i=0;i<m;++i)
+			e[i]=-2.0*fabs(x[start+i]);
+		exponential(e,m);
+		for(size_t i=0;i<m;++i){
+			double t=(1.0-e[i])/(1.0+e[i]);
+			x[start+i] = x[start+i]<0 ? -t : t;
+		}
+	}
+}
+void setFastTranscendentals(bool fast){
+	fastTranscendentals=fast;
+}
 
 namespace pipeline{
 namespace impl{
@@ -21,6 +21,7 @@
  *      Author: Marc Claesen
  */
 
+#include "config.h"
 #include "SparseVector.hpp"
 #include "Kernel.hpp"
 #include "Models.hpp"
@@ -39,6 +40,20 @@
 #include <fstream>
 #include <iomanip>
 #include <limits>
+#include <algorithm>
+#include <iterator>
+#include <cstdlib>
+#include <cstdint>
+
+#ifdef HAVE_UNISTD_H
+#include <unistd.h>
+#endif
+#if defined(_POSIX_MAPPED_FILES) && _POSIX_MAPPED_FILES>0
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#define USE_MMAP
+#endif
 
 using std::endl;
 using std::string;
@@ -47,45 +62,202 @@ using std::istringstream;
 using std::istream;
 using namespace ensemble;
 
+namespace{
+
+// powers of ten that are exact in double precision
+const double EXACT_POWERS_OF_TEN[] = {
+	1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+	1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+// longest number TextScanner accepts, in characters
+const size_t MAX_NUMBER_LENGTH = 127;
+
+bool is_blank(int c){
+	return c==' ' || c=='\t' || c=='\r';
+}
+
+bool is_digit(int c){
+	return c>='0' && c<='9';
+}
+
+} // anonymous namespace
+
 namespace ensemble{
 
 /**
  * General io functions
  */
 
+MappedFile::MappedFile(const std::string &fname){
+#ifdef USE_MMAP
+	int fd=open(fname.c_str(),O_RDONLY);
+	if(fd>=0){
+		struct stat st;
+		if(fstat(fd,&st)==0 && S_ISREG(st.st_mode)){
+			opened=true;
+			length=st.st_size;
+			if(length){
+				void *addr=mmap(nullptr,length,PROT_READ,MAP_PRIVATE,fd,0);
+				if(addr!=MAP_FAILED){
+					content=static_cast<const char*>(addr);
+					mapped=true;
+				}
+			}
+		}
+		close(fd);
+		if(mapped || (opened && !length)) return;
+		opened=false;
+		length=0;
+	}
+#endif
 
-/**
- * 1. Attempts to read an SVMEnsemble.
- * 2. Attempts to read an SVMModel.
- * 3. Attempts to read a LibSVM model and converts it to an SVMModel.
- */
-//unique_ptr<Model> Model::load(const string &fname){
-//	std::ifstream file(fname.c_str(),std::ios::in);
-//	unique_ptr<Model> model;
-//	try{
-//		unique_ptr<SVMEnsemble> ensemble = SVMEnsemble::read(file);
-//		model = unique_ptr<Model>(ensemble.get());
-//		ensemble.release();
-//	}catch(invalid_file_exception &e){
-//		// first try block has read first line, we must reset position
-//		file.clear();
-//		file.seekg(0, std::ios_base::beg);
-//
-//		unique_ptr<SVMModel> svmmodel;
-//		try{
-//			svmmodel = SVMModel::read(file,nullptr);
-//		}catch(invalid_file_exception &e){
-//			file.close();
-//			svm_model *libsvmmodel = svm_load_model(fname.c_str());
-//			svmmodel = LibSVM::convert(unique_ptr<svm_model>(libsvmmodel));
-//		}
-//		model = unique_ptr<Model>(svmmodel.get());
-//		svmmodel.release();
-//	}
-//	if(file.is_open())
-//		file.close();
-//	return model;
-//}
+	// fall back to reading the file
+	std::ifstream file(fname.c_str(),std::ios::in | std::ios::binary);
+	if(!file) return;
+	buffer.assign(std::istreambuf_iterator<char>(file),std::istreambuf_iterator<char>());
+	opened=true;
+	content=buffer.data();
+	length=buffer.size();
+}
+
+MappedFile::~MappedFile(){
+#ifdef USE_MMAP
+	if(mapped) munmap(const_cast<char*>(content),length);
+#endif
+}
+
+MemoryStreamBuffer::MemoryStreamBuffer(const char *data, size_t size){
+	char *begin=const_cast<char*>(data);	// the get area is never written to
+	setg(begin,begin,begin+size);
+}
+
+void MemoryStreamBuffer::skip(size_t n){
+	setg(eback(),gptr()+std::min(n,remaining()),egptr());
+}
+
+MemoryStreamBuffer::pos_type MemoryStreamBuffer::seekoff(off_type off, std::ios_base::seekdir dir, std::ios_base::openmode which){
+	if(!(which & std::ios_base::in)) return pos_type(off_type(-1));
+
+	char *base = dir==std::ios_base::beg ? eback() : dir==std::ios_base::cur ? gptr() : egptr();
+	if(off<eback()-base || off>egptr()-base) return pos_type(off_type(-1));
+	setg(eback(),base+off,egptr());
+	return pos_type(gptr()-eback());
+}
+
+MemoryStreamBuffer::pos_type MemoryStreamBuffer::seekpos(pos_type pos, std::ios_base::openmode which){
+	return seekoff(off_type(pos),std::ios_base::beg,which);
+}
+
+TextScanner::TextScanner(std::istream &is):is(is),memory(dynamic_cast<MemoryStreamBuffer*>(is.rdbuf())){}
+
+void TextScanner::load_line(){
+	loaded=true;
+	if(memory){
+		const char *begin=memory->position();
+		size_t size=memory->remaining();
+		const char *newline=static_cast<const char*>(memchr(begin,'\n',size));
+		exhausted = size==0;
+		cur=begin;
+		end = newline ? newline : begin+size;
+	}else{
+		exhausted = !std::getline(is,buffer);
+		cur=buffer.data();
+		end=cur+buffer.size();
+	}
+}
+
+void TextScanner::next_line(){
+	load();
+	// in memory, the line and its end are consumed here, otherwise getline already did
+	if(memory) memory->skip(end-memory->position()+1);
+	loaded=false;
+	cur=end=nullptr;
+}
+
+bool TextScanner::word(std::string &w){
+	w.clear();
+	if(!skip_blanks()) return false;
+	const char *begin=cur;
+	while(cur<end && !is_blank(*cur)) ++cur;
+	w.assign(begin,cur);
+	return true;
+}
+
+bool TextScanner::number(unsigned &v){
+	if(!skip_blanks()) return false;
+	const char *p=cur;
+	if(*p=='+') ++p;
+	if(p==end || !is_digit(*p)) return false;
+
+	uint64_t result=0;
+	for(;p<end && is_digit(*p);++p){
+		result=result*10+(*p-'0');
+		if(result>std::numeric_limits<unsigned>::max())
+			exit_with_err("Number out of range while reading text.");
+	}
+	v=result;
+	cur=p;
+	return true;
+}
+
+bool TextScanner::number(double &v){
+	if(!skip_blanks()) return false;
+	const char *p=cur;
+	bool negative = *p=='-';
+	if(*p=='-' || *p=='+') ++p;
+
+	// digits are accumulated in a single pass, leading zeros are not significant
+	uint64_t mantissa=0;
+	int significant=0, exponent=0;
+	const char *intbegin=p;
+	for(;p<end && is_digit(*p);++p){
+		mantissa=mantissa*10+(*p-'0');
+		significant+= mantissa!=0;
+	}
+	bool anydigits = p!=intbegin;
+	if(p<end && *p=='.'){
+		const char *fracbegin=++p;
+		for(;p<end && is_digit(*p);++p){
+			mantissa=mantissa*10+(*p-'0');
+			significant+= mantissa!=0;
+		}
+		exponent=-static_cast<int>(p-fracbegin);
+		anydigits = anydigits || p!=fracbegin;
+	}
+	if(!anydigits) return false;
+
+	if(p<end && (*p=='e' || *p=='E')){
+		const char *q=p+1;
+		bool negexp = q<end && *q=='-';
+		if(q<end && (*q=='-' || *q=='+')) ++q;
+		if(q<end && is_digit(*q)){
+			int e=0;
+			for(;q<end && is_digit(*q);++q)
+				if(e<100000) e=e*10+(*q-'0');
+			exponent+= negexp ? -e : e;
+			p=q;
+		}
+	}
+
+	// with at most 19 significant digits the mantissa is exact, if it and the power of ten
+	// are also exact in double precision, a single multiplication or division rounds correctly
+	if(significant<=19 && mantissa<=(uint64_t(1)<<53) && exponent>=-22 && exponent<=22){
+		double result=static_cast<double>(mantissa);
+		result = exponent<0 ? result/EXACT_POWERS_OF_TEN[-exponent] : result*EXACT_POWERS_OF_TEN[exponent];
+		v = negative ? -result : result;
+	}else{
+		size_t length=p-cur;
+		if(length>MAX_NUMBER_LENGTH)
+			exit_with_err("Number too long while reading text.");
+		char text[MAX_NUMBER_LENGTH+1];
+		std::copy(cur,p,text);
+		text[length]='\0';
+		v=strtod(text,nullptr);
+	}
+	cur=p;
+	return true;
+}
 
 unique_ptr< std::deque<double> > ReadIndividualPenaltiesFromFile(const std::string &fname){
 
@@ -23,10 +23,16 @@
 
 #include "SparseVector.hpp"
 #include "Util.hpp"
+#include "io.hpp"
+#include "svm.h"
 #include <iostream>
 #include <string>
 #include <sstream>
 #include <cstdlib>
+#include <cmath>
+#include <cstring>
+#include <cstdint>
+#include <limits>
 
 /*************************************************************************************************/
 
@@ -92,6 +98,44 @@ int main(int argc, char **argv)
 		test_io(av);
 		test_io(bv);
 	}
+	{
+		std::cout << "Testing text parsing." << std::endl;
+		std::vector<std::string> literals={"0","-0","+3",".5","5.","1E5","2.5e-3","1e-320","1.7976931348623157e308",
+				"123456789012345678901234","0.1000000000000000055511151231257827","9007199254740993","4.9e-324"};
+		unsigned seed=1;
+		for(unsigned i=0;i<2000;++i){
+			seed=seed*1103515245+12345;
+			double x=(seed%100000)/7.0*std::pow(10.0,static_cast<int>(seed>>20)%40-20);
+			std::ostringstream os;
+			os.precision(i%2 ? 16 : 17);
+			os << (i%3 ? x : -x);
+			literals.push_back(os.str());
+		}
+
+		std::ostringstream line;
+		for(size_t i=0;i<literals.size();++i)
+			line << (i ? " " : "") << i+1 << ":" << literals[i];
+		line << "\r\n1:0.5,3:2\n";
+		std::string text=line.str();
+
+		// lines are read from a generic stream and in place from memory
+		std::istringstream generic(text);
+		MemoryStreamBuffer buffer(text.data(),text.size());
+		std::istream memory(&buffer);
+		bool error=false;
+		for(std::istream* is: {static_cast<std::istream*>(&generic),&memory}){
+			std::unique_ptr<SparseVector> parsed=SparseVector::read(*is), csv=SparseVector::read(*is,true);
+			error = error || parsed->numNonzero()!=literals.size() || csv->numNonzero()!=2 || (*csv)[3]!=2.0;
+			for(size_t i=0;!error && i<literals.size();++i){
+				double expected=strtod(literals[i].c_str(),nullptr);
+				error = (*parsed)[i+1]!=expected || std::signbit((*parsed)[i+1])!=std::signbit(expected);
+			}
+			error = error || SparseVector::read(*is)->numNonzero()!=0;
+		}
+		error = error || buffer.remaining()!=0;
+		if(error) failure(text,"text parsing");
+		globalerr = globalerr | error;
+	}
 	{
 		std::cout << "Testing SparseVector operator+." << std::endl;
 		std::vector<double> sum={3.0,-1.0,2.0};
@@ -143,6 +187,153 @@ int main(int argc, char **argv)
 		std::shared_ptr<SparseVector> result = linear_combination(vectors, coeff);
 		test_eq(sol,*result);
 	}
+	{
+		std::cout << "Testing SparseMatrix." << std::endl;
+
+		SparseMatrix matrix;
+		matrix.append(a);
+		matrix.append(b);
+		matrix.append(SparseVector(Vector()));
+
+		bool error = matrix.rows()!=3 || matrix.numNonzero()!=4 || matrix.row(2).nnz!=0;
+		for(unsigned i=0;!error && i<a.numNonzero();++i){
+			SparseRow row=matrix.row(0);
+			error = row.indices[i]!=a.begin()[i].first || row.values[i]!=a.begin()[i].second;
+		}
+		error = error || InnerProduct(matrix.row(0),b)!=InnerProduct(a,b);
+		error = error || InnerProduct(matrix.row(1),av)!=InnerProduct(b,av);
+
+		// values are rounded to float in single precision matrices
+		SparseMatrixF single;
+		single.append(a);
+		SparseRowF row=single.row(0);
+		for(unsigned i=0;!error && i<a.numNonzero();++i)
+			error = row.values[i]!=static_cast<float>(a.begin()[i].second);
+		error = error || std::abs(InnerProduct(row,b)-InnerProduct(a,b)) > 1e-6*std::abs(InnerProduct(a,b));
+		error = error || single.transpose().rows()!=a.size()+1;
+		error = error || SparseVector(matrix.row(0))!=a || SparseVector(matrix.row(2)).numNonzero()!=0;
+		error = error || squaredNorm(matrix.row(1))!=squaredNorm(b);
+		error = error || std::abs(squaredNorm(row)-squaredNorm(SparseVector(row))) > 1e-12;
+
+		// int8 matrices hold integral levels
+		SparseMatrix8 levels;
+		levels.append(SparseVector::SparseSV{{2,-3.0},{5,127.0},{9,-128.0}});
+		SparseVector::SparseSV c={{2,1.5},{5,0.25},{7,2.0},{9,0.5}};
+		SparseVector cv(std::move(c));
+		error = error || InnerProduct(levels.row(0),cv)!=-3.0*1.5+127.0*0.25-128.0*0.5;
+		error = error || levels.transpose().row(5).values[0]!=127;
+		if(error) failure(a,"SparseMatrix");
+		globalerr = globalerr | error;
+	}
+	{
+		std::cout << "Testing SparseVectorView." << std::endl;
+		SparseMatrix matrix;
+		matrix.append(b);
+		std::vector<svm_node> nodes;
+		for(auto& nz: b) nodes.push_back(svm_node{static_cast<int>(nz.first),nz.second});
+		nodes.push_back(svm_node{-1,0.0});
+
+		SparseVector zero{Vector()};
+		SparseVectorView vb(b), vrow(matrix.row(0)), vnodes(nodes.data()), empty(zero);
+		bool error = vb.numNonzero()!=b.numNonzero() || vnodes.numNonzero()!=b.numNonzero() || vb.size()!=b.size();
+		error = error || empty.numNonzero()!=0 || empty.size()!=0 || empty.lower_bound(3)!=0;
+		for(unsigned idx=0;!error && idx<=b.size()+1;++idx)
+			error = vb[idx]!=b[idx] || vrow[idx]!=b[idx] || vnodes[idx]!=b[idx];
+		error = error || SparseVector(vnodes)!=b || SparseVector(vrow)!=b;
+		error = error || InnerProduct(SparseVectorView(a),vnodes)!=InnerProduct(a,b);
+		error = error || std::abs(squaredDistance(SparseVectorView(a),vrow)-squaredDistance(a,b)) > 1e-12;
+		error = error || squaredNorm(vnodes)!=squaredNorm(b);
+		if(error) failure(b,"SparseVectorView");
+		globalerr = globalerr | error;
+	}
+	{
+		std::cout << "Testing SparseVector hashing." << std::endl;
+		SparseVector::SparseSV zero={{1,1.0},{2,0.0}}, negzero={{1,1.0},{2,-0.0}};
+		SparseVector z(std::move(zero)), nz(std::move(negzero));
+		bool error = a.hash()!=av.hash() || b.hash()!=bv.hash() || a.hash()==b.hash();
+		error = error || z.hash()!=nz.hash();
+		if(error) failure(a,"hash");
+		globalerr = globalerr | error;
+	}
+	{
+		std::cout << "Testing dense kernels (" << denseKernelISA() << ")." << std::endl;
+
+		bool error=false;
+		for(size_t n=0;!error && n<40;++n){
+			Vector x(n), y(n);
+			std::vector<float> xf(n);
+			std::vector<int8_t> x8(n);
+			double dot=0.0, dotf=0.0, dot8=0.0, sqdist=0.0, sqnorm=0.0;
+			for(size_t i=0;i<n;++i){
+				x[i]=0.5*i-3.0;
+				y[i]=1.0/(i+1);
+				xf[i]=static_cast<float>(0.1*i-1.0);
+				x8[i]=static_cast<int8_t>(i%2 ? 127-7*i : 5*i-128);
+				dot+=x[i]*y[i];
+				dotf+=xf[i]*y[i];
+				dot8+=x8[i]*y[i];
+				sqdist+=(x[i]-y[i])*(x[i]-y[i]);
+				sqnorm+=x[i]*x[i];
+			}
+			error = std::abs(InnerProduct(x.data(),y.data(),n)-dot) > 1e-10
+					|| std::abs(InnerProduct(xf.data(),y.data(),n)-dotf) > 1e-10
+					|| std::abs(InnerProduct(x8.data(),y.data(),n)-dot8) > 1e-10
+					|| std::abs(squaredDistance(x.data(),y.data(),n)-sqdist) > 1e-10
+					|| std::abs(squaredNorm(x.data(),n)-sqnorm) > 1e-10;
+		}
+		if(error) failure(a,"dense kernel");
+		globalerr = globalerr | error;
+	}
+
+	{
+		std::cout << "Testing batch exp and tanh." << std::endl;
+
+		bool error=false;
+		for(int fast=0;!error && fast<2;++fast){
+			setFastTranscendentals(fast);
+			double exptol = fast ? 1e-8 : 1e-14, tanhtol = fast ? 1e-8 : 1e-15;
+
+			Vector x, y;
+			for(double v=-750.0;v<709.7;v+=0.731) x.push_back(v);
+			for(double v=-20.0;v<20.0;v+=0.0173) y.push_back(v);
+			Vector ex(x), ty(y);
+			exponential(ex.data(),ex.size());
+			hyperbolicTangent(ty.data(),ty.size());
+			for(size_t i=0;!error && i<x.size();++i){
+				double ref=exp(x[i]);
+				if(x[i]<-708.0) error = ex[i]!=0.0;
+				else error = std::abs(ex[i]-ref) > exptol*ref;
+			}
+			for(size_t i=0;!error && i<y.size();++i)
+				error = std::abs(ty[i]-tanh(y[i])) > tanhtol;
+
+			// values evaluated on their own match the batch exactly
+			for(size_t i=0;!error && i<x.size();i+=7){
+				double e=x[i], t=y[i];
+				exponential(&e,1);
+				hyperbolicTangent(&t,1);
+				error = e!=ex[i] || t!=ty[i];
+			}
+
+			// NaN propagates, small arguments keep their relative accuracy without fast mode
+			Vector special={std::numeric_limits<double>::quiet_NaN(),1e-9,-3e-12,1e-300};
+			Vector es(special), ts(special);
+			exponential(es.data(),es.size());
+			hyperbolicTangent(ts.data(),ts.size());
+			// NaN is detected by its bits, comparisons may be folded away under -ffast-math
+			auto isnan_bits=[](double v){
+				uint64_t bits;
+				std::memcpy(&bits,&v,sizeof(v));
+				return (bits & 0x7FFFFFFFFFFFFFFFull) > 0x7FF0000000000000ull;
+			};
+			error = error || !isnan_bits(es[0]) || !isnan_bits(ts[0]);
+			for(size_t i=1;!fast && !error && i<special.size();++i)
+				error = std::abs(ts[i]-tanh(special[i])) > 1e-15*std::abs(special[i]);
+		}
+		setFastTranscendentals(false);
+		if(error) failure(a,"batch exp/tanh");
+		globalerr = globalerr | error;
+	}
 
 	if(globalerr) exit(EXIT_FAILURE);
 	else exit(EXIT_SUCCESS);
@@ -25,10 +25,18 @@
 #include "Ensemble.hpp"
 #include "SelectiveFactory.hpp"
 #include "Executable.hpp"
+#include "Approximation.hpp"
+#include "BinaryWorkflow.hpp"
+#include "io.hpp"
+#include "svm.h"
 #include <iostream>
 #include <string>
 #include <sstream>
+#include <fstream>
+#include <cstdio>
 #include <cstdlib>
+#include <cmath>
+#include <algorithm>
 
 /*************************************************************************************************/
 
@@ -60,16 +68,160 @@ bool test_io(const SVMEnsemble& m){
 	str2=buffer2.str();
 
 	bool error = (str1.compare(str2)!=0);
+
+	// binary format, read from a stream and in place from memory
+	std::ostringstream binary;
+	m.serialize_binary(binary);
+	std::string bytes=binary.str();
+	std::vector<uint64_t> aligned(bytes.size()/sizeof(uint64_t)+1);
+	std::copy(bytes.begin(),bytes.end(),reinterpret_cast<char*>(aligned.data()));
+	MemoryStreamBuffer memory(reinterpret_cast<const char*>(aligned.data()),bytes.size());
+
+	std::istringstream stream3(bytes);
+	std::istream stream4(&memory);
+	for(std::istream* is: {static_cast<std::istream*>(&stream3),&stream4}){
+		deserialized=BinaryModel::deserialize(*is);
+		std::ostringstream text;
+		text << *deserialized;
+		error = error || text.str().compare(str1)!=0 || is->peek()!=EOF;
+	}
+	error = error || memory.remaining()!=0;
 	if(error) failure(m,"io");
 	return error;
 }
 
-/*************************************************************************************************/
+bool test_batch(const SVMEnsemble& m, const std::vector<SparseVector>& instances){
+	// the instances are repeated so that the batch spans several instance tiles
+	std::vector<const SparseVector*> batch;
+	for(size_t i=0;i<100;++i)
+		batch.push_back(&instances[i%instances.size()]);
 
-int main(int argc, char **argv)
-{
-	bool globalerr=false;
+	std::vector<std::vector<double>> decvals=m.decision_values(batch);
+	bool error = (decvals.size()!=batch.size());
+	for(size_t i=0;!error && i<batch.size();++i){
+		std::vector<double> expected=m.decision_value(*batch[i]);
+		error = (decvals[i].size()!=expected.size());
+		for(size_t j=0;!error && j<expected.size();++j)
+			error = std::abs(decvals[i][j]-expected[j]) > 1e-10;
+	}
+	if(error) failure(m,"batch prediction");
+	return error;
+}
+
+/**
+ * Compares decision values to those obtained with merge-based kernel evaluations.
+ */
+bool test_kernel_evaluations(const SVMEnsemble& m, const std::vector<SparseVector>& instances){
+	bool error=false;
+	for(auto& x: instances){
+		std::vector<double> decvals=m.decision_value(x);
+		size_t idx=0;
+		for(SVMEnsemble::const_iterator I=m.begin(),E=m.end();!error && I!=E;++I,++idx){
+			const SVMModel* model=I->first;
+			double expected=-model->getConstant(0);
+			SVMModel::const_weight_iter Iw=model->weight_begin();
+			for(SVMModel::const_iterator Isv=model->begin(),Esv=model->end();Isv!=Esv;++Isv,++Iw)
+				expected += *Iw * m.getKernel()->k_function(Isv->get(),&x);
+			error = std::abs(decvals[idx]-expected) > 1e-10;
+		}
+	}
+	if(error) failure(m,"kernel evaluation");
+	return error;
+}
+
+/**
+ * Checks that predictions of a quantized ensemble equal those after saving and loading it,
+ * and that they match kernel evaluations with the rounded SVs that are loaded.
+ */
+bool test_rounded(const SVMEnsemble& m, const std::vector<SparseVector>& instances){
+	std::stringstream binary;
+	m.serialize_binary(binary);
+	std::unique_ptr<BinaryModel> loaded=BinaryModel::deserialize(binary);
+	const SVMEnsemble& rounded=dynamic_cast<const SVMEnsemble&>(*loaded);
+	bool error = rounded.numDistinctSV()!=m.numDistinctSV() || test_kernel_evaluations(rounded,instances);
+	for(size_t j=0;!error && j<instances.size();++j){
+		std::vector<double> expected=m.decision_value(instances[j]), actual=rounded.decision_value(instances[j]);
+		for(size_t i=0;!error && i<expected.size();++i)
+			error = std::abs(expected[i]-actual[i]) > 1e-10;
+	}
+	if(error) failure(m,"rounded SVs");
+	return error;
+}
+
+bool test_dense(const SVMEnsemble& m, const std::vector<SparseVector>& instances){
+	bool error=false;
+	for(auto& x: instances){
+		std::vector<double> sparse=m.decision_value(x), dense=m.decision_value(x.dense());
+		for(size_t i=0;!error && i<sparse.size();++i)
+			error = std::abs(sparse[i]-dense[i]) > 1e-10;
+	}
+	if(error) failure(m,"dense prediction");
+	return error;
+}
+
+bool test_base_models(const SVMEnsemble& m, const std::vector<SparseVector>& instances){
+	bool error=false;
+	for(auto& x: instances){
+		std::vector<double> decvals=m.decision_value(x);
+		error = error || (decvals.size()!=m.size());
+		size_t idx=0;
+		for(SVMEnsemble::const_iterator I=m.begin(),E=m.end();!error && I!=E;++I,++idx)
+			error = std::abs(decvals[idx]-I->first->decision_value(x)[0]) > 1e-10;
+	}
+	if(error) failure(m,"base model decision values");
+	return error;
+}
+
+/**
+ * Compares lazily computed decision values to regular ones, which must be identical so that
+ * early decisions match predict(), also with fast transcendentals.
+ */
+bool test_lazy(const SVMEnsemble& m, const std::vector<SparseVector>& instances){
+	bool error=false;
+	for(int fast=0;!error && fast<2;++fast){
+		setFastTranscendentals(fast);
+		for(auto& x: instances){
+			std::vector<double> decvals=m.decision_value(x);
+			std::vector<double> lazy=m.lazy_decision_value(x,[](size_t, double){ return false; });
+			std::vector<double> first=m.lazy_decision_value(x,[](size_t, double){ return true; });
+			error = error || lazy!=decvals || first.size()!=1 || first[0]!=decvals[0];
+		}
+	}
+	setFastTranscendentals(false);
+	if(error) failure(m,"lazy decision values");
+	return error;
+}
+
+/**
+ * Compares base model decision values of an approximation to the exact ensemble,
+ * and checks that the approximation survives serialization.
+ */
+bool test_approximation(const SVMEnsemble& m, const ApproximateEnsemble& approx,
+		const std::vector<SparseVector>& instances, double tolerance, const char* name){
+	bool error=false;
+	for(const SparseVector& x: instances){
+		std::vector<double> exact=m.decision_value(x), approximate=approx.decision_value(x);
+		error = error || (exact.size()!=approximate.size());
+		for(size_t i=0;!error && i<exact.size();++i)
+			error = std::abs(exact[i]-approximate[i]) > tolerance;
+	}
+
+	std::stringbuf buffer;
+	std::iostream stream(&buffer);
+	stream << approx;
+	std::unique_ptr<BinaryModel> deserialized = BinaryModel::deserialize(stream);
+	for(size_t j=0;!error && j<instances.size();++j){
+		std::vector<double> original=approx.decision_value(instances[j]), copy=deserialized->decision_value(instances[j]);
+		for(size_t i=0;!error && i<original.size();++i)
+			error = std::abs(original[i]-copy[i]) > 1e-8;
+	}
+	if(error) failure(m,name);
+	return error;
+}
+
+/*************************************************************************************************/
 
+std::vector<std::unique_ptr<SVMModel>> build_models(const Kernel& kernel){
 	SVMModel::SV_container SVs1, SVs2;
 	{
 		std::vector<double> v={1.0,0.0,2.0};
@@ -86,21 +238,518 @@ int main(int argc, char **argv)
 	}
 
 	std::vector<std::unique_ptr<SVMModel>> models;
+	SVMModel::Classes classes1, classes2;
+	classes1.emplace_back("positive",1);
+	classes1.emplace_back("negative",1);
+	classes2=classes1;
+
+	models.emplace_back(new SVMModel(std::move(SVs1),{1.0,-1.0},std::move(classes1),{0.0},kernel.clone()));
+	models.emplace_back(new SVMModel(std::move(SVs2),{1.0,-1.0},std::move(classes2),{0.0},kernel.clone()));
+	return models;
+}
+
+/**
+ * Builds <nummodels> models with an SV per weight, SV i of model m is generator(m,i).
+ *
+ * SVs with positive weights belong to the positive class, model m has constant 0.1*m.
+ */
+std::vector<std::unique_ptr<SVMModel>> build_models(const Kernel& kernel, unsigned nummodels,
+		const SVMModel::Weights& weights, const std::function<SparseVector(unsigned,unsigned)>& generator){
+	unsigned numpositive=std::count_if(weights.begin(),weights.end(),[](double w){ return w>0; });
+	std::vector<std::unique_ptr<SVMModel>> models;
+	for(unsigned m=0;m<nummodels;++m){
+		SVMModel::SV_container SVs;
+		for(unsigned i=0;i<weights.size();++i)
+			SVs.emplace_back(new SparseVector(generator(m,i)));
+		SVMModel::Classes classes;
+		classes.emplace_back("positive",numpositive);
+		classes.emplace_back("negative",weights.size()-numpositive);
+		models.emplace_back(new SVMModel(std::move(SVs),SVMModel::Weights(weights),std::move(classes),{0.1*m},kernel.clone()));
+	}
+	return models;
+}
+
+/**
+ * Builds models with very sparse, high dimensional SVs.
+ */
+std::vector<std::unique_ptr<SVMModel>> build_sparse_models(const Kernel& kernel){
+	return build_models(kernel,3,{0.5,1.0,-0.75,-0.75},[](unsigned m, unsigned i){
+		return SparseVector(SparseVector::SparseSV({{1+m+i,1.0},{50*i+7,-0.5*m},{997+i,0.25}}));
+	});
+}
+
+/**
+ * Builds models that mix dense blocks of features with sparse, one-hot encoded features.
+ */
+std::vector<std::unique_ptr<SVMModel>> build_mixed_models(const Kernel& kernel){
+	return build_models(kernel,2,{0.5,0.25,0.1,-0.5,-0.25,-0.1},[](unsigned m, unsigned j){
+		// dense and one-hot SVs alternate
+		unsigned i=j/2;
+		if(j%2) return SparseVector(SparseVector::SparseSV({{3+i+m,1.0},{40+10*i,1.0},{200+m,1.0}}));
+		SparseVector::SparseSV dense;
+		for(unsigned f=10+i;f<30;++f)
+			if(f%7) dense.emplace_back(f,0.05*f-0.1*i-0.2*m);
+		return SparseVector(std::move(dense));
+	});
+}
+
+/**
+ * Builds models with dense SVs of different lengths and starting features.
+ */
+std::vector<std::unique_ptr<SVMModel>> build_dense_models(const Kernel& kernel, unsigned numfeatures){
+	return build_models(kernel,3,{0.5,0.25,-0.5,-0.25},[numfeatures](unsigned m, unsigned i){
+		SparseVector::SparseSV content;
+		for(unsigned f=1+i;f<=numfeatures-2*m;++f)
+			content.emplace_back(f,std::sin(0.3*f+i+0.5*m));
+		return SparseVector(std::move(content));
+	});
+}
+
+/**
+ * Builds models whose SVs are perturbed copies of each other.
+ */
+std::vector<std::unique_ptr<SVMModel>> build_noisy_models(const Kernel& kernel){
+	return build_models(kernel,3,{0.5,0.25,-0.75},[](unsigned m, unsigned i){
+		double noise=1e-9*m;
+		std::vector<Vector> svs={{1.0+noise,0.0,2.0},{1.0,0.0,2.0-noise},{-1.0,1.0+noise}};
+		return SparseVector(svs[i]);
+	});
+}
+
+/**
+ * Merges near-duplicate SVs and compares decision values to the original ensemble.
+ */
+bool test_merge(const Kernel& kernel){
+	SVMEnsemble original(build_noisy_models(kernel)), merged(build_noisy_models(kernel));
+	bool error = original.numDistinctSV()!=8;
+
+	// identical SVs within a base model are merged even without tolerance
+	error = error || merged.merge(0.0)!=0 || merged.numTotalSV()!=8;
+	error = error || merged.merge(1e-6)!=6 || merged.numDistinctSV()!=2 || merged.numTotalSV()!=6;
+
+	std::vector<SparseVector> instances;
+	instances.emplace_back(Vector({1.0,2.0,3.0}));
+	instances.emplace_back(Vector({0.0,-1.0,0.0,2.0}));
+	for(size_t j=0;!error && j<instances.size();++j){
+		std::vector<double> exact=original.decision_value(instances[j]), approximate=merged.decision_value(instances[j]);
+		for(size_t i=0;!error && i<exact.size();++i)
+			error = std::abs(exact[i]-approximate[i]) > 1e-6;
+	}
+	error = error || test_io(merged);
+	if(error) failure(merged,"SV merging");
+	return error;
+}
+
+/**
+ * Reads an ensemble that is large enough to be parsed in parallel in place and compares it to the original.
+ */
+bool test_parallel_read(const SVMEnsemble& m){
+	std::ostringstream text;
+	text << m;
+	std::string str=text.str(), trailer="trailer\n";
+	std::string bytes=str+trailer;
+
+	SVMEnsemble::set_read_threads(4);
+	MemoryStreamBuffer memory(bytes.data(),bytes.size());
+	std::istream is(&memory);
+	std::unique_ptr<BinaryModel> deserialized=BinaryModel::deserialize(is);
+	SVMEnsemble::set_read_threads(0);
+
+	std::ostringstream copy;
+	copy << *deserialized;
+	bool error = copy.str().compare(str)!=0 || memory.remaining()!=trailer.size();
+	if(error) std::cerr << "parallel read test failed" << std::endl;
+	return error;
+}
+
+/**
+ * Compares predictions of an ensemble that is large enough to split single
+ * predictions over threads against sequential predictions.
+ */
+bool test_threads(const Kernel& kernel){
+	std::vector<std::unique_ptr<SVMModel>> models;
+	unsigned seed=1;
+	for(unsigned m=0;m<4;++m){
+		SVMModel::SV_container SVs;
+		SVMModel::Weights weights;
+		for(unsigned i=0;i<5000;++i){
+			SparseVector::SparseSV content;
+			for(unsigned f=1;f<=20;f+=1+(seed=seed*1103515245+12345)%3)
+				content.emplace_back(f,((seed=seed*1103515245+12345)%1000)/1000.0);
+			SVs.emplace_back(new SparseVector(std::move(content)));
+			weights.push_back(i%2 ? 0.01 : -0.01);
+		}
+		SVMModel::Classes classes;
+		classes.emplace_back("positive",2500);
+		classes.emplace_back("negative",2500);
+		models.emplace_back(new SVMModel(std::move(SVs),std::move(weights),std::move(classes),{0.1*m},kernel.clone()));
+	}
+	SVMEnsemble ensemble(std::move(models));
+
+	std::vector<SparseVector> instances;
+	instances.emplace_back(Vector({1.0,0.2,0.3,0.0,0.5}));
+	instances.emplace_back(SparseVector::SparseSV({{3,-1.0},{17,0.5}}));
+	std::vector<std::vector<double>> sequential, sequentialdense;
+	for(const SparseVector& x: instances){
+		sequential.push_back(ensemble.decision_value(x));
+		sequentialdense.push_back(ensemble.decision_value(x.dense()));
+	}
+
+	ensemble.set_num_threads(4);
+	bool error=false;
+	for(unsigned repeat=0;repeat<10;++repeat){
+		for(size_t i=0;!error && i<instances.size();++i)
+			error = ensemble.decision_value(instances[i])!=sequential[i]
+				|| ensemble.decision_value(instances[i].dense())!=sequentialdense[i];
+	}
+	if(error) failure(*ensemble.getKernel(),"intra-query parallelism");
+	return error | test_parallel_read(ensemble);
+}
+
+/**
+ * Compares kernel evaluations on rows of double and single precision matrices to those on SparseVectors.
+ */
+bool test_matrix_rows(const Kernel& kernel){
+	std::vector<SparseVector> vectors;
+	vectors.emplace_back(Vector({1.0,0.0,2.0}));
+	vectors.emplace_back(SparseVector::SparseSV({{2,0.1},{5,-1.5},{9,0.75}}));
+	vectors.emplace_back(Vector());
+
+	SparseMatrix matrix;
+	SparseMatrixF single;
+	for(const SparseVector& v: vectors){
+		matrix.append(v);
+		single.append(v);
+	}
+
+	bool error=false;
+	for(size_t i=0;!error && i<vectors.size();++i){
+		SparseVector rounded(single.row(i));
+		for(size_t j=0;!error && j<vectors.size();++j){
+			error = std::abs(kernel.k_function(matrix.row(i),vectors[j])-kernel.k_function(&vectors[i],&vectors[j])) > 1e-12
+				|| std::abs(kernel.k_function(single.row(i),vectors[j])-kernel.k_function(&rounded,&vectors[j])) > 1e-12;
+		}
+	}
+	if(error) failure(kernel,"matrix row kernel evaluation");
+	return error;
+}
+
+/**
+ * Compares predictions on views of svm_node arrays, matrix rows and separate arrays to those on SparseVectors,
+ * with and without a PredictionContext.
+ */
+bool test_views(const SVMEnsemble& m, const std::vector<SparseVector>& instances){
+	std::unique_ptr<SVMModel> combined=m.combine({1.0},0.0);
+	const Model& model=m;
+
+	SparseMatrix matrix;
+	for(const SparseVector& x: instances)
+		matrix.append(x);
+
+	bool error=false;
+	for(size_t i=0;!error && i<instances.size();++i){
+		const SparseVector& x=instances[i];
+		std::vector<svm_node> nodes;
+		std::vector<unsigned> indices;
+		std::vector<double> values;
+		for(auto& nz: x){
+			nodes.push_back(svm_node{static_cast<int>(nz.first),nz.second});
+			indices.push_back(nz.first);
+			values.push_back(nz.second);
+		}
+		nodes.push_back(svm_node{-1,0.0});
+
+		std::vector<double> expected=m.decision_value(x);
+		std::vector<std::vector<double>> found;
+		found.push_back(m.decision_value(SparseVectorView(nodes.data())));
+		found.push_back(m.decision_value(matrix.row(i)));
+		found.push_back(m.decision_value(SparseVectorView(indices.data(),values.data(),indices.size())));
+		found.push_back(model.decision_value(nodes.data()));
+		for(auto& decvals: found){
+			for(size_t j=0;j<expected.size();++j)
+				error = error || std::abs(decvals[j]-expected[j]) > 1e-12;
+		}
+		error = error || std::abs(combined->decision_value(SparseVectorView(nodes.data()))[0]-combined->decision_value(x)[0]) > 1e-12;
+		error = error || m.predict(matrix.row(i)).getLabel()!=m.predict(x).getLabel();
+
+		// predictions into a context reuse its buffers
+		PredictionContext ctx(m);
+		const double *cache=ctx.cache.data(), *decvals=ctx.decision_values.data();
+		const Prediction& pred=m.predict(ctx,SparseVectorView(nodes.data()));
+		error = error || !std::equal(expected.begin(),expected.end(),pred.begin()+1)
+				|| pred.getLabel()!=m.predict(x).getLabel();
+		error = error || ctx.cache.data()!=cache || ctx.decision_values.data()!=decvals;
+	}
+	if(error) failure(m,"sparse vector view");
+	return error;
+}
+
+/**
+ * Compares single precision predictions to double precision and checks that switching back is lossless.
+ */
+bool test_single_precision(SVMEnsemble& m, const std::vector<SparseVector>& instances){
+	std::vector<std::vector<double>> exact;
+	for(const SparseVector& x: instances)
+		exact.push_back(m.decision_value(x));
+
+	m.set_single_precision(true);
+	bool error = !m.single_precision();
+	for(size_t j=0;!error && j<instances.size();++j){
+		std::vector<double> sparse=m.decision_value(instances[j]), dense=m.decision_value(instances[j].dense());
+		for(size_t i=0;!error && i<exact[j].size();++i)
+			error = std::abs(sparse[i]-exact[j][i]) > 1e-5*(1.0+std::abs(exact[j][i]))
+				|| std::abs(dense[i]-sparse[i]) > 1e-10;
+	}
+	error = error || test_io(m) || test_batch(m,instances);
+
+	m.set_single_precision(false);
+	for(size_t j=0;!error && j<instances.size();++j)
+		error = m.decision_value(instances[j])!=exact[j];
+	if(error) failure(m,"single precision");
+	return error;
+}
+
+/**
+ * Predicts with an ensemble of dense SVs, which are laid out as a dense matrix, before and
+ * after rounding it to int8 and adding a model with longer SVs.
+ */
+bool test_dense_matrix(const Kernel& kernel){
+	std::vector<SparseVector> instances;
+	for(unsigned length: {50,20,45}){
+		Vector v(length);
+		for(unsigned f=0;f<length;++f) v[f]=std::cos(0.2*f)-0.25;
+		instances.emplace_back(v);
+	}
+	instances.emplace_back(SparseVector::SparseSV({{2,1.0},{17,-0.5},{44,0.25},{60,1.0}}));
+
+	SVMEnsemble m(build_dense_models(kernel,45));
+	bool error = test_kernel_evaluations(m,instances) || test_dense(m,instances) || test_batch(m,instances)
+			|| test_lazy(m,instances) || test_views(m,instances);
+
+	// int8 levels are laid out the same way
+	m.quantize(SVMEnsemble::INT8_VALUES);
+	error = error || test_rounded(m,instances) || test_dense(m,instances) || test_batch(m,instances);
+	m.quantize(SVMEnsemble::DOUBLE_VALUES);
+
+	m.add(std::move(build_dense_models(kernel,55)[0]));
+	error = error || test_kernel_evaluations(m,instances) || test_dense(m,instances) || test_single_precision(m,instances);
+	if(error) failure(m,"dense matrix");
+	return error;
+}
+
+/**
+ * Quantizes SV values and checks that predictions are close to the original ones and match the
+ * rounded SVs, also after adding a model, that binary models are smaller, that saving and
+ * loading a quantized ensemble is lossless and that the original SVs are kept.
+ */
+bool test_quantization(const Kernel& kernel, const std::vector<SparseVector>& instances){
+	SVMEnsemble original(build_mixed_models(kernel));
+	std::ostringstream full;
+	original.serialize_binary(full);
+
+	bool error=false;
+	const double tolerances[]={1e-6,1e-2,5e-2};
+	for(unsigned encoding=SVMEnsemble::FLOAT_VALUES;!error && encoding<=SVMEnsemble::INT8_VALUES;++encoding){
+		SVMEnsemble m(build_mixed_models(kernel));
+		m.quantize(static_cast<SVMEnsemble::ValueEncoding>(encoding));
+		error = m.value_encoding()!=encoding;
+		for(size_t j=0;!error && j<instances.size();++j){
+			std::vector<double> exact=original.decision_value(instances[j]), approx=m.decision_value(instances[j]);
+			for(size_t i=0;!error && i<exact.size();++i)
+				error = std::abs(approx[i]-exact[i]) > tolerances[encoding-1]*(1.0+std::abs(exact[i]));
+		}
+		error = error || test_rounded(m,instances) || test_dense(m,instances) || test_batch(m,instances)
+				|| test_lazy(m,instances) || test_views(m,instances);
+
+		std::ostringstream text, binary, requantized;
+		text << m;
+		m.serialize_binary(binary);
+		m.quantize(static_cast<SVMEnsemble::ValueEncoding>(encoding));
+		requantized << m;
+		error = error || binary.str().size()>=full.str().size() || text.str().compare(requantized.str())!=0;
+		error = error || test_io(m);
+
+		m.add(std::move(build_sparse_models(kernel)[0]));
+		error = error || test_rounded(m,instances) || test_dense(m,instances);
+		if(error) failure(m,"quantization");
+	}
+	if(error) return error;
+
+	// encodings do not compound and doubles restore the exact predictions
+	SVMEnsemble m(build_mixed_models(kernel)), direct(build_mixed_models(kernel));
+	m.quantize(SVMEnsemble::FLOAT_VALUES);
+	m.quantize(SVMEnsemble::INT8_VALUES);
+	direct.quantize(SVMEnsemble::INT8_VALUES);
+	for(size_t j=0;!error && j<instances.size();++j)
+		error = m.decision_value(instances[j])!=direct.decision_value(instances[j]);
+	m.quantize(SVMEnsemble::DOUBLE_VALUES);
+	for(size_t j=0;!error && j<instances.size();++j)
+		error = m.decision_value(instances[j])!=original.decision_value(instances[j]);
+	error = error || m.numDistinctSV()!=original.numDistinctSV();
+	if(error) failure(m,"requantization");
+	return error;
+}
+
+/**
+ * Loads a selection of base models from files in text and binary format, with and without a workflow
+ * around the ensemble, and compares their decision values to those of the original models.
+ */
+bool test_selection(const Kernel& kernel, const std::vector<SparseVector>& instances){
+	SVMEnsemble original(build_sparse_models(kernel));
+	std::vector<unsigned> selection={2,0};
+	std::vector<std::vector<double>> expected;
+	for(const SparseVector& x: instances)
+		expected.push_back(original.decision_value(x));
+
+	const char* fname="test_svmensemble.selection.tmp";
+	bool error=false;
+	for(unsigned format=0;!error && format<4;++format){
+		{
+			std::ofstream file(fname,std::ios::out | std::ios::binary);
+			if(format<2){
+				if(format==0) file << original;
+				else original.serialize_binary(file);
+			}else{
+				auto flow=defaultBinaryWorkflow(std::unique_ptr<BinaryModel>(new SVMEnsemble(build_sparse_models(kernel))));
+				if(format==2) file << *flow;
+				else flow->serialize_binary(file);
+			}
+		}
+		std::unique_ptr<SVMEnsemble> subset=SVMEnsemble::load(fname,selection);
+		error = subset->size()!=selection.size() || subset->numDistinctSV()!=8;
+		for(size_t j=0;!error && j<instances.size();++j){
+			std::vector<double> decvals=subset->decision_value(instances[j]);
+			for(size_t i=0;!error && i<selection.size();++i)
+				error = std::abs(decvals[i]-expected[j][selection[i]]) > 1e-12;
+		}
+		error = error || test_io(*subset);
+	}
+	std::remove(fname);
+	if(error) failure(original,"base model selection");
+	return error;
+}
+
+bool test_ensemble(const SVMEnsemble& ensemble){
+	bool globalerr = test_io(ensemble);
+
+	std::vector<SparseVector> instances;
+	instances.emplace_back(Vector({1.0,2.0,3.0}));
+	instances.emplace_back(Vector({0.0,-1.0,0.0,2.0}));
+	instances.emplace_back(Vector({0.5}));
 	{
-		SVMModel::Classes classes1, classes2;
-		classes1.emplace_back("positive",1);
-		classes1.emplace_back("negative",1);
-		classes2=classes1;
+		Vector v(37,0.0);
+		for(size_t i=0;i<v.size();i+=2) v[i]=0.1*i-1.0;
+		instances.emplace_back(v);
+	}
+	globalerr = globalerr | test_kernel_evaluations(ensemble,instances);
+	globalerr = globalerr | test_dense(ensemble,instances);
+	globalerr = globalerr | test_batch(ensemble,instances);
+	globalerr = globalerr | test_base_models(ensemble,instances);
+	globalerr = globalerr | test_lazy(ensemble,instances);
+	return globalerr;
+}
 
-		std::unique_ptr<Kernel> linear(new LinearKernel());
-		models.emplace_back(new SVMModel(std::move(SVs1),{1.0,-1.0},std::move(classes1),{0.0},std::move(linear)));
+/*************************************************************************************************/
 
-		linear.reset(new LinearKernel());
-		models.emplace_back(new SVMModel(std::move(SVs2),{1.0,-1.0},std::move(classes2),{0.0},std::move(linear)));
+int main(int argc, char **argv)
+{
+	bool globalerr=false;
 
+	{
 		std::cout << "Testing SVMEnsemble with linear kernel." << std::endl;
-		SVMEnsemble ensemble(std::move(models));
-		globalerr = globalerr | test_io(ensemble);
+		SVMEnsemble ensemble(build_models(LinearKernel()));
+		globalerr = globalerr | test_ensemble(ensemble);
+		globalerr = globalerr | test_merge(LinearKernel());
+	}
+	{
+		std::cout << "Testing SVMEnsemble with RBF kernel." << std::endl;
+		SVMEnsemble ensemble(build_models(RBFKernel(0.5)));
+		globalerr = globalerr | test_ensemble(ensemble);
+
+		std::vector<SparseVector> instances;
+		instances.emplace_back(Vector({1.0,2.0,3.0}));
+		instances.emplace_back(Vector({0.0,-1.0,0.0,2.0,0.5}));
+		instances.emplace_back(Vector({0.5}));
+		globalerr = globalerr | test_approximation(ensemble,*ApproximateEnsemble::nystroem(ensemble,10,1),
+				instances,1e-6,"Nystroem approximation");
+		globalerr = globalerr | test_approximation(ensemble,*ApproximateEnsemble::fourier(ensemble,4000,1),
+				instances,0.1,"random Fourier feature approximation");
+		globalerr = globalerr | test_merge(RBFKernel(0.5));
+	}
+
+	{
+		std::cout << "Testing sparse SVMEnsemble with RBF kernel." << std::endl;
+		SVMEnsemble ensemble(build_sparse_models(RBFKernel(0.5)));
+		globalerr = globalerr | test_ensemble(ensemble);
+
+		std::vector<SparseVector> instances;
+		instances.emplace_back(SparseVector::SparseSV({{2,1.0},{57,0.5},{998,-1.0},{5000,2.0}}));
+		instances.emplace_back(SparseVector::SparseSV({{3,-1.0},{107,0.5}}));
+		globalerr = globalerr | test_kernel_evaluations(ensemble,instances);
+		globalerr = globalerr | test_batch(ensemble,instances);
+		globalerr = globalerr | test_single_precision(ensemble,instances);
+		globalerr = globalerr | test_views(ensemble,instances);
+	}
+	{
+		std::cout << "Testing sparse SVMEnsemble with linear kernel." << std::endl;
+		SVMEnsemble ensemble(build_sparse_models(LinearKernel()));
+		globalerr = globalerr | test_ensemble(ensemble);
+
+		std::vector<SparseVector> instances;
+		instances.emplace_back(SparseVector::SparseSV({{2,1.0},{57,0.5},{998,-1.0},{5000,2.0}}));
+		instances.emplace_back(SparseVector::SparseSV({{3,-1.0},{107,0.5}}));
+		globalerr = globalerr | test_kernel_evaluations(ensemble,instances);
+		globalerr = globalerr | test_batch(ensemble,instances);
+		globalerr = globalerr | test_base_models(ensemble,instances);
+		globalerr = globalerr | test_selection(LinearKernel(),instances);
+		globalerr = globalerr | test_selection(RBFKernel(0.5),instances);
+	}
+	{
+		std::cout << "Testing sparse SVMEnsemble with polynomial kernel." << std::endl;
+		SVMEnsemble ensemble(build_sparse_models(PolyKernel(2,1.0,0.5)));
+		globalerr = globalerr | test_ensemble(ensemble);
+	}
+
+	{
+		std::cout << "Testing mixed dense and sparse SVMEnsemble." << std::endl;
+		std::vector<SparseVector> instances;
+		instances.emplace_back(SparseVector::SparseSV({{4,1.0},{12,0.5},{28,-1.0},{50,1.0},{201,1.0}}));
+		instances.emplace_back(SparseVector::SparseSV({{15,2.0},{300,1.0}}));
+		{
+			Vector v(60,0.0);
+			for(size_t i=8;i<v.size();++i) v[i]=0.02*i-0.5;
+			instances.emplace_back(v);
+		}
+
+		SVMEnsemble linear(build_mixed_models(LinearKernel())), rbf(build_mixed_models(RBFKernel(0.1)));
+		SVMEnsemble poly(build_mixed_models(PolyKernel(2,1.0,0.5)));
+		SVMEnsemble sigmoid(build_mixed_models(SigmoidKernel(0.05,-0.25)));
+		for(SVMEnsemble* ensemble: {&linear,&rbf,&poly,&sigmoid}){
+			globalerr = globalerr | test_ensemble(*ensemble);
+			globalerr = globalerr | test_kernel_evaluations(*ensemble,instances);
+			globalerr = globalerr | test_dense(*ensemble,instances);
+			globalerr = globalerr | test_batch(*ensemble,instances);
+			globalerr = globalerr | test_single_precision(*ensemble,instances);
+			globalerr = globalerr | test_views(*ensemble,instances);
+		}
+		globalerr = globalerr | test_quantization(RBFKernel(0.1),instances);
+		globalerr = globalerr | test_dense_matrix(RBFKernel(0.05));
+		globalerr = globalerr | test_dense_matrix(PolyKernel(2,1.0,0.1));
+		globalerr = globalerr | test_quantization(LinearKernel(),instances);
+	}
+
+	{
+		std::cout << "Testing kernels on matrix rows." << std::endl;
+		globalerr = globalerr | test_matrix_rows(LinearKernel());
+		globalerr = globalerr | test_matrix_rows(PolyKernel(3,0.5,1.0));
+		globalerr = globalerr | test_matrix_rows(RBFKernel(0.5));
+		globalerr = globalerr | test_matrix_rows(SigmoidKernel(0.5,-0.25));
+	}
+
+	{
+		std::cout << "Testing intra-query parallelism." << std::endl;
+		globalerr = globalerr | test_threads(RBFKernel(0.5));
+		globalerr = globalerr | test_threads(PolyKernel(2,1.0,0.5));
 	}
 
 	if(globalerr) exit(EXIT_FAILURE);
@@ -29,7 +29,11 @@
 #include <iostream>
 #include <string>
 #include <sstream>
+#include <fstream>
+#include <cstdio>
 #include <cstdlib>
+#include <cmath>
+#include <algorithm>
 
 /*************************************************************************************************/
 
@@ -61,10 +65,89 @@ bool test_io(const BinaryWorkflow& m){
 	str2=buffer2.str();
 
 	bool error = (str1.compare(str2)!=0);
+
+	// binary format, loaded from a mapped file
+	const char* fname="test_workflow.binary.tmp";
+	{
+		std::ofstream file(fname,std::ios::out | std::ios::binary);
+		m.serialize_binary(file);
+	}
+	deserialized=BinaryModel::load(fname);
+	std::remove(fname);
+	std::ostringstream text;
+	text << *deserialized;
+	error = error || text.str().compare(str1)!=0;
+
 	if(error) failure(m,"io");
 	return error;
 }
 
+bool test_predict_label(const BinaryWorkflow& m){
+	std::vector<Vector> instances={
+			{1.0,0.0,2.0}, {-1.0,1.0}, {1.0,0.0,0.0,4.0}, {0.0,-3.0,1.0},
+			{-2.0,0.5,0.0,1.0}, {0.0,0.0,0.0,-1.0}, {0.5,-0.5,0.5}
+	};
+
+	bool error=false;
+	for(auto& v: instances){
+		SparseVector sv(v);
+		Prediction pred=m.predict_label(sv);
+		if(pred.getLabel().compare(m.predict(sv).getLabel())!=0 || pred.begin()!=pred.end()){
+			error=true;
+			failure(m,"predict_label");
+		}
+	}
+	return error;
+}
+
+/**
+ * Compares predictions into a reused PredictionContext to regular predictions.
+ */
+bool test_context(const BinaryWorkflow& m){
+	std::vector<Vector> instances={
+			{1.0,0.0,2.0}, {-1.0,1.0}, {1.0,0.0,0.0,4.0}, {0.0,-3.0,1.0}, {0.5,-0.5,0.5}
+	};
+
+	PredictionContext ctx(m);
+	bool error=false;
+	for(auto& v: instances){
+		SparseVector sv(v);
+		Prediction expected=m.predict(sv);
+		const Prediction& pred=m.predict(ctx,sv);
+		error = error || pred.getLabel()!=expected.getLabel()
+				|| !std::equal(expected.begin(),expected.end(),pred.begin());
+
+		// the predictor's scratch space is reused as is
+		const double *cache=ctx.cache.data();
+		m.get_predictor()->decision_value(ctx,sv);
+		error = error || ctx.cache.data()!=cache;
+	}
+	if(error) failure(m,"prediction context");
+	return error;
+}
+
+/**
+ * Folds the aggregation of m and verifies that its decision values do not change.
+ */
+bool test_fold(BinaryWorkflow& m){
+	std::vector<Vector> instances={
+			{1.0,0.0,2.0}, {-1.0,1.0}, {1.0,0.0,0.0,4.0}, {0.0,-3.0,1.0}, {0.5,-0.5,0.5}
+	};
+	// only the aggregated output is compared, base model outputs disappear when folding
+	std::vector<std::vector<double>> expected;
+	for(auto& v: instances)
+		expected.push_back(m.decision_value(SparseVector(v)));
+
+	bool error=!m.fold_aggregation();
+	error = error || dynamic_cast<const SVMModel*>(m.get_predictor())==nullptr;
+	for(size_t i=0;!error && i<instances.size();++i){
+		std::vector<double> folded=m.decision_value(SparseVector(instances[i]));
+		error = std::abs(folded[0]-expected[i][0]) > 1e-10;
+	}
+	if(error) failure(m,"fold");
+	return error;
+}
+
 /*************************************************************************************************/
 
 int main(int argc, char **argv)
@@ -118,6 +201,7 @@ int main(int argc, char **argv)
 		}
 		flow->set_preprocessing(std::move(pre));
 		globalerr = globalerr | test_io(*flow);
+		globalerr = globalerr | test_context(*flow);
 	}
 
 	std::vector<std::unique_ptr<SVMModel>> models;
@@ -158,6 +242,15 @@ int main(int argc, char **argv)
 		}
 		flow->set_postprocessing(std::move(post));
 		globalerr = globalerr | test_io(*flow);
+		globalerr = globalerr | test_predict_label(*flow);
+		globalerr = globalerr | test_context(*flow);
+
+		// majority vote with a threshold that may be decided by the first model
+		flow->set_threshold(0.5);
+		globalerr = globalerr | test_predict_label(*flow);
+		flow->set_threshold(-0.5);
+		globalerr = globalerr | test_predict_label(*flow);
+		flow->set_threshold(0.0);
 
 		// set postprocessing to LR
 		{
@@ -167,6 +260,28 @@ int main(int argc, char **argv)
 
 		flow->set_postprocessing(std::move(post));
 		globalerr = globalerr | test_io(*flow);
+		globalerr = globalerr | test_predict_label(*flow);
+		globalerr = globalerr | test_context(*flow);
+
+		// fold weighted aggregations into a single model
+		{
+			pipeline::Factory<pipeline::LogisticRegression> f;
+			post.reset(f({0.5,2.0},0.3).release());
+		}
+		flow->set_postprocessing(std::move(post));
+		std::stringstream stream;
+		stream << *flow;
+		globalerr = globalerr | test_fold(*flow);
+		globalerr = globalerr | test_io(*flow);
+
+		std::unique_ptr<BinaryModel> model=BinaryModel::deserialize(stream);
+		std::unique_ptr<BinaryWorkflow> copy(dynamic_cast<BinaryWorkflow*>(model.release()));
+		{
+			pipeline::Factory<pipeline::LinearAggregation> f;
+			post.reset(f({0.5,2.0},-0.3).release());
+		}
+		copy->set_postprocessing(std::move(post));
+		globalerr = globalerr | test_fold(*copy);
 	}
 
 	if(globalerr) exit(EXIT_FAILURE);
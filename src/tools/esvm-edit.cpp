@@ -28,12 +28,16 @@
 #include "Util.hpp"
 #include "pipeline/pipelines.hpp"
 #include "BinaryWorkflow.hpp"
+#include "Approximation.hpp"
+#include "DataFile.hpp"
 #include "LibSVM.hpp"
 #include "Executable.hpp"
 
 #include <iostream>
 #include <sstream>
 #include <fstream>
+#include <cmath>
+#include <algorithm>
 
 /*************************************************************************************************/
 
@@ -143,6 +147,43 @@ std::pair<std::vector<double>,double> readFile(const std::string& fname, bool of
 	return std::move(p);
 }
 
+/**
+ * Returns the workflow's predictions for all instances in data.
+ */
+std::vector<Prediction> predictAll(const BinaryWorkflow& flow, const DataFile& data){
+	std::vector<Prediction> predictions;
+	predictions.reserve(data.size());
+	for(unsigned i=0;i<data.size();++i)
+		predictions.push_back(flow.predict(data[i]));
+	return predictions;
+}
+
+/**
+ * Prints the differences between exact and approximate predictions to standard output.
+ */
+void reportApproximation(const std::vector<Prediction>& exact, const std::vector<Prediction>& approx){
+	double baseerr=0.0, basemax=0.0, outerr=0.0;
+	size_t numbase=0, agree=0;
+	for(size_t i=0;i<exact.size();++i){
+		if(exact[i].getLabel().compare(approx[i].getLabel())==0) ++agree;
+		outerr+=std::abs(exact[i].getScore(0)-approx[i].getScore(0));
+
+		// remaining scores are base model decision values
+		for(Prediction::const_iterator Ie=exact[i].begin()+1,Ia=approx[i].begin()+1,E=exact[i].end();Ie!=E;++Ie,++Ia){
+			double err=std::abs(*Ie-*Ia);
+			baseerr+=err;
+			basemax=std::max(basemax,err);
+			++numbase;
+		}
+	}
+
+	std::cout << "Approximation error on " << exact.size() << " validation instances" << std::endl;
+	std::cout << "base model decision values: mean absolute error " << baseerr/numbase
+			<< ", maximum absolute error " << basemax << std::endl;
+	std::cout << "workflow output: mean absolute error " << outerr/exact.size()
+			<< ", label agreement " << (1.0*agree)/exact.size() << std::endl;
+}
+
 /*************************************************************************************************/
 
 int main(int argc, char **argv)
@@ -235,6 +276,73 @@ int main(int argc, char **argv)
 	CLI::Argument<double> threshold(description,keyword,CLI::Argument<double>::Content(1,0.5));
 	allargs.push_back(&threshold);
 
+	keyword = "-fold";
+	multilinedesc.push_back("fold the aggregation into a single SVM model over the distinct SVs");
+	multilinedesc.push_back("requires an ensemble with logistic regression or linear aggregation");
+	multilinedesc.push_back("predictions remain identical, applied after -post");
+	CLI::FlagArgument fold(multilinedesc,keyword,false);
+	allargs.push_back(&fold);
+	multilinedesc.clear();
+
+	keyword = "-merge";
+	multilinedesc.push_back("merge distinct SVs within given Euclidean distance of each other");
+	multilinedesc.push_back("reduces prediction cost and model size, applied before -approx");
+	CLI::Argument<double> merge(multilinedesc,keyword,CLI::Argument<double>::Content(1,0.0));
+	allargs.push_back(&merge);
+	multilinedesc.clear();
+
+	keyword = "-approx";
+	multilinedesc.push_back("replace the SVM ensemble by an approximation with given amount of features");
+	multilinedesc.push_back("prediction cost no longer depends on the amount of SVs (cfr. -approxtype)");
+	CLI::Argument<unsigned> approximate(multilinedesc,keyword,CLI::Argument<unsigned>::Content(1,0));
+	allargs.push_back(&approximate);
+	multilinedesc.clear();
+
+	keyword = "-approxtype";
+	multilinedesc.push_back("feature map used by -approx");
+	multilinedesc.push_back("1 -- random Fourier features (RBF kernel only)");
+	multilinedesc.push_back("2 -- Nystroem method, landmarks are sampled from the SVs");
+	CLI::Argument<unsigned> approxtype(multilinedesc,keyword,CLI::Argument<unsigned>::Content(1,1));
+	allargs.push_back(&approxtype);
+	multilinedesc.clear();
+
+	keyword = "-float";
+	multilinedesc.push_back("store SVs and coefficients of the SVM ensemble in single precision");
+	multilinedesc.push_back("halves memory traffic of predictions, 0 reverts to double precision");
+	CLI::Argument<unsigned> singleprecision(multilinedesc,keyword,CLI::Argument<unsigned>::Content(1,1));
+	allargs.push_back(&singleprecision);
+	multilinedesc.clear();
+
+	keyword = "-quantize";
+	multilinedesc.push_back("round SV values of the SVM ensemble to a compact encoding, stored as such by -binary");
+	multilinedesc.push_back("1 -- single precision");
+	multilinedesc.push_back("2 -- half precision");
+	multilinedesc.push_back("3 -- 8 bit integers, scaled per feature");
+	multilinedesc.push_back("0 stores values in double precision again, rounding is permanent");
+	CLI::Argument<unsigned> quantize(multilinedesc,keyword,CLI::Argument<unsigned>::Content(1,0));
+	allargs.push_back(&quantize);
+	multilinedesc.clear();
+
+	description = "save the workflow with its SVM ensemble in binary format, which loads faster (default: off)";
+	keyword = "-binary";
+	CLI::FlagArgument binary(description,keyword,false);
+	allargs.push_back(&binary);
+
+	description = "seed used to sample the approximation (default: 0)";
+	keyword = "-seed";
+	CLI::Argument<unsigned> seed(description,keyword,CLI::Argument<unsigned>::Content(1,0));
+	allargs.push_back(&seed);
+
+	description = "data file used to report the error due to -merge, -approx, -float and -quantize";
+	keyword = "-validate";
+	CLI::Argument<string> validation(description,keyword,CLI::Argument<string>::Content(1,""));
+	allargs.push_back(&validation);
+
+	description = "validation data file contains labels (default: off)";
+	keyword = "-labeled";
+	CLI::FlagArgument labeled(description,keyword,false);
+	allargs.push_back(&labeled);
+
 	ParseCLI(argv,argc,1,allargs);
 
 	if(help.configured() || help2.configured())
@@ -255,6 +363,23 @@ int main(int argc, char **argv)
 		std::cerr << "Postprocessing scheme not specified but parameters given.";
 		err=true;
 	}
+	if(approximate.configured() && approximate[0]==0){
+		std::cerr << "Approximations require at least one feature (see -approx).";
+		err=true;
+	}
+	if(merge.configured() && merge[0]<0){
+		std::cerr << "Merge tolerance must be positive (see -merge).";
+		err=true;
+	}
+	if(validation.configured() && !approximate.configured() && !merge.configured() && !singleprecision.configured()
+			&& !quantize.configured()){
+		std::cerr << "Validation data specified but no approximation requested (see -merge, -approx, -float, -quantize).";
+		err=true;
+	}
+	if(quantize.configured() && quantize[0]>SVMEnsemble::INT8_VALUES){
+		std::cerr << "Invalid number specified for -quantize.";
+		err=true;
+	}
 	if(err)
 		exit_with_err("Invalid configuration specified via command line.");
 
@@ -363,6 +488,80 @@ int main(int argc, char **argv)
 		modified=true;
 	}
 
+	// replace ensemble and aggregation by a single model if requested
+
+	if(fold.value()){
+		if(!flow->fold_aggregation())
+			exit_with_err("Folding requires an SVM ensemble with logistic regression or linear aggregation.");
+		modified=true;
+	}
+
+	// approximate the ensemble if requested, predictions before and after are compared on validation data
+
+	unique_ptr<DataFile> data(nullptr);
+	std::vector<Prediction> exact;
+	if(validation.configured()){
+		if(labeled.value())
+			data=LabeledDataFile::readf(validation[0]);
+		else
+			data=DataFile::readf(validation[0]);
+		exact=predictAll(*flow,*data);
+	}
+
+	if(merge.configured()){
+		std::unique_ptr<BinaryModel> predictor=flow->release_predictor();
+		SVMEnsemble* ens=dynamic_cast<SVMEnsemble*>(predictor.get());
+		if(!ens) exit_with_err("Merging SVs requires a workflow around an SVM ensemble.");
+
+		size_t removed=ens->merge(merge[0]);
+		std::cout << "Merged " << removed << " SVs, " << ens->numDistinctSV() << " distinct SVs remain." << std::endl;
+		flow->set_prediction(std::move(predictor));
+		modified=true;
+	}
+
+	if(singleprecision.configured()){
+		std::unique_ptr<BinaryModel> predictor=flow->release_predictor();
+		SVMEnsemble* ens=dynamic_cast<SVMEnsemble*>(predictor.get());
+		if(!ens) exit_with_err("Single precision requires a workflow around an SVM ensemble.");
+
+		ens->set_single_precision(singleprecision[0]!=0);
+		flow->set_prediction(std::move(predictor));
+		modified=true;
+	}
+
+	if(quantize.configured()){
+		std::unique_ptr<BinaryModel> predictor=flow->release_predictor();
+		SVMEnsemble* ens=dynamic_cast<SVMEnsemble*>(predictor.get());
+		if(!ens) exit_with_err("Quantization requires a workflow around an SVM ensemble.");
+
+		ens->quantize(static_cast<SVMEnsemble::ValueEncoding>(quantize[0]));
+		flow->set_prediction(std::move(predictor));
+		modified=true;
+	}
+
+	if(approximate.configured()){
+		std::unique_ptr<BinaryModel> predictor=flow->release_predictor();
+		const SVMEnsemble* ens=dynamic_cast<const SVMEnsemble*>(predictor.get());
+		if(!ens) exit_with_err("Approximations require a workflow around an SVM ensemble.");
+
+		std::unique_ptr<BinaryModel> approx;
+		switch(approxtype[0]){
+		case 1:
+			approx.reset(ApproximateEnsemble::fourier(*ens,approximate[0],seed[0]).release());
+			break;
+		case 2:
+			approx.reset(ApproximateEnsemble::nystroem(*ens,approximate[0],seed[0]).release());
+			break;
+		default:
+			exit_with_err("Invalid number specified in for -approxtype.");
+		}
+		flow->set_prediction(std::move(approx));
+		modified=true;
+	}
+
+	if(validation.configured())
+		reportApproximation(exact,predictAll(*flow,*data));
+
 	// modify threshold if specified
 
 	if(threshold.configured()){
@@ -370,15 +569,24 @@ int main(int argc, char **argv)
 		modified=true;
 	}
 
+	if(binary.value())
+		modified=true;
+
 	/*************************************************************************************************/
 
 	// save modified workflow and exit
 
 	if(modified){
 		std::string outputfilename = ofile.configured() ? ofile[0] : model[0];
-		std::ofstream ofstream(outputfilename.c_str());
-		ofstream << *flow;
-		ofstream.close();
+		if(binary.value()){
+			std::ofstream ofstream(outputfilename.c_str(),std::ios::out | std::ios::binary);
+			flow->serialize_binary(ofstream);
+			ofstream.close();
+		}else{
+			std::ofstream ofstream(outputfilename.c_str());
+			ofstream << *flow;
+			ofstream.close();
+		}
 	}
 
 	exit(EXIT_SUCCESS);
@@ -28,6 +28,7 @@
 #include "Util.hpp"
 #include "Models.hpp"
 #include "Ensemble.hpp"
+#include "BinaryWorkflow.hpp"
 #include "DataFile.hpp"
 #include "ThreadPool.hpp"
 #include "Executable.hpp"
@@ -51,6 +52,23 @@ using namespace ensemble;
 
 std::string toolname("esvm-predict");
 
+// predictions are returned by reference to buffers that the predictor reuses
+typedef std::function<const Prediction&(const SparseVectorView&)> Predictor;
+
+/**
+ * The parts of a prediction that are written to the output.
+ *
+ * Labels are short enough for std::string to store them inline, so that outcomes without
+ * base model decision values are built without allocating.
+ */
+struct Outcome{
+	Prediction::Label label;
+	Prediction::Score score=0.0;
+	Prediction full;		// only with base model decision values
+	bool correct=true;
+	double baseacc=0.0;
+};
+
 /*************************************************************************************************/
 
 /**
@@ -58,6 +76,7 @@ std::string toolname("esvm-predict");
  */
 double baseScore(const Prediction& pred, bool truth){
 	Prediction::const_iterator I=pred.begin(),E=pred.end();
+	if(std::distance(I,E)<2) return 0.0; // no base model decision values
 	++I;
 	unsigned size = std::distance(I,E);
 	unsigned numpos = std::count_if(I,E,[](double x){ return x > 0.0; });
@@ -69,32 +88,33 @@ double baseScore(const Prediction& pred, bool truth){
 
 /*************************************************************************************************/
 
-#ifdef HAVE_PTHREAD
-
-std::tuple<Prediction,bool,double> predict(const std::string& poslabel, const Model& model, std::shared_ptr<ConstDataLine> line){
-	Prediction pred=model.predict(*line->rawSV());
-	double baseacc;
+/**
+ * Predicts the instance on line and scores it against its label, if any.
+ */
+Outcome predict(const std::string& poslabel, const Predictor& model, bool keepscores, std::shared_ptr<ConstDataLine> line){
+	const Prediction& pred=model(line->rawView());
+	Outcome outcome;
+	outcome.label=pred.getLabel();
+	if(pred.begin()!=pred.end()) outcome.score=*pred.begin();
+	if(keepscores) outcome.full=pred;
 
-	bool correct=true;
 	if(line->labeled()){
 		// number of positive predictions by base models
-		baseacc=baseScore(pred,true);
+		outcome.baseacc=baseScore(pred,true);
 		if(line->rawLabel()->compare(poslabel)==0){ // positive label
-			if(poslabel.compare(pred.getLabel())!=0){
-				correct=false;
+			if(poslabel.compare(outcome.label)!=0){
+				outcome.correct=false;
 			}
 		}else{
-			baseacc=1-baseacc;
-			if(poslabel.compare(pred.getLabel())==0){
-				correct=false;
+			outcome.baseacc=1-outcome.baseacc;
+			if(poslabel.compare(outcome.label)==0){
+				outcome.correct=false;
 			}
 		}
 	}
-	return std::make_tuple(std::move(pred),correct,baseacc);
+	return outcome;
 }
 
-#endif
-
 /*************************************************************************************************/
 
 int main(int argc, char **argv)
@@ -179,6 +199,41 @@ int main(int argc, char **argv)
 	CLI::FlagArgument base(description,keyword,false);
 	allargs.push_back(&base);
 
+	multilinedesc.push_back("only output labels, which allows majority voting ensembles to stop");
+	multilinedesc.push_back("evaluating base models once the vote is decided (default: off)");
+	keyword = "-early";
+	CLI::FlagArgument early(multilinedesc,keyword,false);
+	allargs.push_back(&early);
+	multilinedesc.clear();
+
+	multilinedesc.push_back("use fast approximations of exp and tanh in RBF and sigmoid kernels");
+	multilinedesc.push_back("errors per kernel evaluation are below 1e-8 (default: off)");
+	keyword = "-fast";
+	CLI::FlagArgument fast(multilinedesc,keyword,false);
+	allargs.push_back(&fast);
+	multilinedesc.clear();
+
+	multilinedesc.push_back("split each prediction of an SVM ensemble over given number of threads");
+	multilinedesc.push_back("instances are then predicted one at a time, useful for very large ensembles");
+	keyword = "-querythreads";
+	CLI::Argument<unsigned> querythreads(multilinedesc,keyword,CLI::Argument<unsigned>::Content(1,1));
+	allargs.push_back(&querythreads);
+	multilinedesc.clear();
+
+	multilinedesc.push_back("store SVs and coefficients of an SVM ensemble in single precision");
+	multilinedesc.push_back("halves memory traffic of kernel evaluations (default: as in model)");
+	keyword = "-float";
+	CLI::FlagArgument singleprecision(multilinedesc,keyword,false);
+	allargs.push_back(&singleprecision);
+	multilinedesc.clear();
+
+	multilinedesc.push_back("store the test data in one packed sparse matrix, 12 bytes per nonzero");
+	multilinedesc.push_back("instead of 16 and no allocation per instance (default: off)");
+	keyword = "-packed";
+	CLI::FlagArgument packed(multilinedesc,keyword,false);
+	allargs.push_back(&packed);
+	multilinedesc.clear();
+
 	ParseCLI(argv,argc,1,allargs);
 
 	if(help.configured() || help2.configured())
@@ -202,9 +257,19 @@ int main(int argc, char **argv)
 		std::cerr << "Specified cross-validation index but not mask." << std::endl;
 		validargs=false;
 	}
+	if(early.value() && base.value()){
+		std::cerr << "Base model decision values are not available with -early." << std::endl;
+		validargs=false;
+	}
+	if(querythreads.configured() && querythreads[0]==0){
+		std::cerr << "Number of threads must be > 0 (see -querythreads)." << std::endl;
+		validargs=false;
+	}
 	if(!validargs)
 		exit_with_err("Invalid command line arguments provided.");
 
+	setFastTranscendentals(fast.value());
+
 	/*************************************************************************************************/
 
 	// get correct list of indices if bootstrap mask is specified
@@ -227,30 +292,70 @@ int main(int argc, char **argv)
 	if(labeled){
 		unique_ptr<LabeledDataFile> labdata(nullptr);
 		if(csv)
-			labdata=LabeledDataFile::readf(datafname[0], FileFormats::CSV, indices);
+			labdata=LabeledDataFile::readf(datafname[0], FileFormats::CSV, indices, packed.value());
 		else if(sparsecsv)
-			labdata=LabeledDataFile::readf(datafname[0], FileFormats::SparseCSV, indices);
+			labdata=LabeledDataFile::readf(datafname[0], FileFormats::SparseCSV, indices, packed.value());
 		else
-			labdata=LabeledDataFile::readf(datafname[0], FileFormats::DEFAULT, indices);
+			labdata=LabeledDataFile::readf(datafname[0], FileFormats::DEFAULT, indices, packed.value());
 		data=unique_ptr<DataFile>(dynamic_cast<DataFile*>(labdata.release()));
 	}else{
 		if(csv)
-			data=DataFile::readf(datafname[0], FileFormats::CSV);
+			data=DataFile::readf(datafname[0], FileFormats::CSV, packed.value());
 		else if(sparsecsv)
-			data=DataFile::readf(datafname[0], FileFormats::SparseCSV);
+			data=DataFile::readf(datafname[0], FileFormats::SparseCSV, packed.value());
 		else
-			data=DataFile::readf(datafname[0], FileFormats::DEFAULT);
+			data=DataFile::readf(datafname[0], FileFormats::DEFAULT, packed.value());
+	}
+
+	// configure intra-query parallelism and precision of SVM ensembles, possibly wrapped in a workflow
+	if(querythreads.configured() || singleprecision.value()){
+		auto configure=[&](SVMEnsemble *ens){
+			if(!ens) exit_with_err("Options -querythreads and -float require an SVM ensemble.");
+			if(querythreads.configured()) ens->set_num_threads(querythreads[0]);
+			if(singleprecision.value()) ens->set_single_precision(true);
+		};
+		BinaryWorkflow *flow=dynamic_cast<BinaryWorkflow*>(model.get());
+		if(flow){
+			std::unique_ptr<BinaryModel> predictor=flow->release_predictor();
+			configure(dynamic_cast<SVMEnsemble*>(predictor.get()));
+			flow->set_prediction(std::move(predictor));
+		}else{
+			configure(dynamic_cast<SVMEnsemble*>(model.get()));
+		}
 	}
 
 	string poslabel=model->positive_label();
 
+	const BinaryWorkflow *workflow=dynamic_cast<const BinaryWorkflow*>(model.get());
+	Predictor predictor;
+	if(early.value() && workflow)
+		predictor=[workflow](const SparseVectorView& v) -> const Prediction& {
+			static thread_local Prediction pred;
+			pred=workflow->predict_label(v);
+			return pred;
+		};
+	else if(early.value())
+		predictor=[&model](const SparseVectorView& v) -> const Prediction& {
+			static thread_local Prediction pred;
+			pred=Prediction(model->predict(v).getLabel(),Prediction::ScoreCont());
+			return pred;
+		};
+	else
+		predictor=[&model](const SparseVectorView& v) -> const Prediction& {
+			// one context per thread, so scratch buffers are reused over instances
+			static thread_local PredictionContext ctx(*model);
+			return model->predict(ctx,v);
+		};
+
 	/*************************************************************************************************/
 
 #ifdef HAVE_PTHREAD
-	std::function<std::tuple<Prediction,bool,double>(std::shared_ptr<ConstDataLine>)> fun =
-			std::bind(predict,std::cref(poslabel),std::cref(*model.get()),std::placeholders::_1);
+	std::function<Outcome(std::shared_ptr<ConstDataLine>)> fun =
+			std::bind(predict,std::cref(poslabel),std::cref(predictor),base.value(),std::placeholders::_1);
 
-	ThreadPool<std::tuple<Prediction,bool,double>(std::shared_ptr<ConstDataLine>)> manager(std::move(fun));
+	// instances are predicted sequentially when predictions are already split over threads
+	unsigned numthreads = querythreads[0]>1 ? 1 : NUM_HARDWARE_THREADS;
+	ThreadPool<Outcome(std::shared_ptr<ConstDataLine>)> manager(std::move(fun),numthreads);
 #endif
 
 	/*************************************************************************************************/
@@ -273,10 +378,7 @@ int main(int argc, char **argv)
 		manager.addjob(dataline);
 	}
 	for(auto& job: manager){
-		std::tuple<Prediction,bool,double> result=job.get();
-		Prediction pred=std::get<0>(result);
-		if(std::get<1>(result)) numcorrect++;
-		baseacc+=std::get<2>(result);
+		Outcome outcome=job.get();
 
 		/*************************************************************************************************/
 
@@ -284,47 +386,30 @@ int main(int argc, char **argv)
 
 		/*************************************************************************************************/
 
-		Prediction pred=model->predict(*dataline->rawSV());
-		double basepos=0.0;
-		if(labeled){
-			basepos = baseScore(pred,true);
-			const std::string& label=*dataline->rawLabel();
-			if(pred.getLabel().compare(poslabel)==0){ // positive prediction
-				if(label.compare(poslabel)==0){
-					// true positive
-					++numcorrect;
-						baseacc+=basepos;
-				}else{
-					baseacc+=1-basepos;
-				}
-			}else{ // negative prediction
-				if(label.compare(poslabel)==0){
-					// false negative
-						baseacc+=basepos;
-
-				}else{
-					// true negative
-					++numcorrect;
-						baseacc+=1-basepos;
-				}
-			}
-		}
+		Outcome outcome=predict(poslabel,predictor,base.value(),dataline);
 
 		/*************************************************************************************************/
 
 #endif
 
 		/*************************************************************************************************/
+		if(outcome.correct) numcorrect++;
+		baseacc+=outcome.baseacc;
 		numinstances++;
 		if(base.value())
-			outfile << pred << std::endl;
+			outfile << outcome.full << std::endl;
+		else if(early.value())
+			outfile << outcome.label << std::endl;
 		else
-			outfile << pred.getLabel() << " " << pred[0] << std::endl;
+			outfile << outcome.label << " " << outcome.score << std::endl;
 	}
 
 	if(labeled){
 		double acc=(1.0*numcorrect)/numinstances;
-		std::cout << "Accuracy: " << acc << " base model accuracy: " << baseacc/numinstances << std::endl;
+		std::cout << "Accuracy: " << acc;
+		if(!early.value())
+			std::cout << " base model accuracy: " << baseacc/numinstances;
+		std::cout << std::endl;
 	}
 
 	return 0;
@@ -26,6 +26,7 @@
 #include <iostream>
 #include <sstream>
 #include <fstream>
+#include <numeric>
 #include "CLI.hpp"
 #include "Util.hpp"
 #include "SparseVector.hpp"
@@ -140,6 +141,8 @@ int main(int argc, char **argv)
 			"Merges models <model1> and <model2> into an ensemble model with majority voting.\n"
 			"OR\n"
 			"merges models <basename><start> to <basename><stop> into an ensemble model.\n"
+			"OR\n"
+			"keeps base models <start> to <stop> of the ensemble in <model1> (see -models).\n"
 			"Please note that all models must use the same kernel. \n"
 			"Base models can be generic SVM models or LIBSVM models. \n\n"
 			"Options:\n"
@@ -190,6 +193,13 @@ int main(int argc, char **argv)
 	CLI::Argument<unsigned> range(description,keyword,CLI::Argument<unsigned>::Content(2,0));
 	allargs.push_back(&range);
 
+	keyword="-models";
+	multilinedesc.clear();
+	multilinedesc.push_back("base models of the ensemble in -model1 to keep: <start> <stop> (0-based)");
+	multilinedesc.push_back("only these models are read from ensembles in binary format");
+	CLI::Argument<unsigned> models(multilinedesc,keyword,CLI::Argument<unsigned>::Content(2,0));
+	allargs.push_back(&models);
+
 	description = "output file";
 	keyword = "-o";
 	CLI::Argument<string> ofile(description,keyword,CLI::Argument<string>::Content(1,""));
@@ -217,12 +227,21 @@ int main(int argc, char **argv)
 	if(base && range && ofile){
 		ensemble=mergeRange(base[0],range[0],range[1]);
 
-	}else if(model1 && model2 && ofile){
-		// merging 2 models
-		ensemble=readFirstModel(model1[0]);
-
-		unique_ptr<SVMModel> svmmodel=loadSVMModel(model2[0]);
-		ensemble->add(std::move(svmmodel));
+	}else if(model1 && (model2 || models) && ofile){
+		// merging 2 models, possibly after selecting base models of the first
+		if(models){
+			if(models[0] > models[1])
+				exit_with_err("Start > stop specified in -models!");
+			std::vector<unsigned> selection(models[1]-models[0]+1);
+			std::iota(selection.begin(),selection.end(),models[0]);
+			ensemble=SVMEnsemble::load(model1[0],selection);
+		}else{
+			ensemble=readFirstModel(model1[0]);
+		}
+		if(model2){
+			unique_ptr<SVMModel> svmmodel=loadSVMModel(model2[0]);
+			ensemble->add(std::move(svmmodel));
+		}
 
 	}else{
 		exit_with_err("Illegal command line options specified.");